@@ -0,0 +1,861 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sys.h"
+#include "sim.h"
+#include "sim_local.h"
+
+// --------------------------------------------------------------------------------
+// Bodies
+
+#define NUM_CMD_PATTERNS	256
+#define MAX_SPAWNS			4096
+
+static usercmd_t cmdpatterns[NUM_CMD_PATTERNS];
+
+static int numspawns;
+static float spawns[MAX_SPAWNS][2];
+
+static void InitCommands()
+{
+	unsigned int seed = 1234;
+
+	for (int i = 0; i < NUM_CMD_PATTERNS; i++)
+	{
+		bool keys[NUM_KEY_ACTIONS];
+
+		seed = seed * 1103515245 + 12345;
+		for (int k = 0; k < NUM_KEY_ACTIONS; k++)
+			keys[k] = (seed >> (16 + k)) & 1;
+
+		BuildMoveCommand(cmdpatterns[i], keys);
+	}
+}
+
+// each body holds a pattern for 16 frames, with bodies out of phase
+static const usercmd_t &BodyCommand(int body, unsigned int frame)
+{
+	return cmdpatterns[(body * 7 + (frame >> 4)) & (NUM_CMD_PATTERNS - 1)];
+}
+
+static void InitSpawns()
+{
+	numspawns = 0;
+
+	for (int y = 0; y < Map_Height() && numspawns < MAX_SPAWNS; y++)
+	{
+		for (int x = 0; x < Map_Width() && numspawns < MAX_SPAWNS; x++)
+		{
+			float sx = x * TILE_SIZE + TILE_SIZE / 2;
+			float sy = y * TILE_SIZE + TILE_SIZE / 2;
+
+			if (Map_Tile(sx, sy) & TILE_CONTENTS)
+				continue;
+
+			spawns[numspawns][0] = sx;
+			spawns[numspawns][1] = sy;
+			numspawns++;
+		}
+	}
+}
+
+static void SpawnBody(body_t &body, int i)
+{
+	memset(&body, 0, sizeof(body));
+	body.objx = body.nextx = spawns[i % numspawns][0];
+	body.objy = body.nexty = spawns[i % numspawns][1];
+}
+
+// bodies that escape the map are respawned so they never read outside it
+static bool OutsideMap(float x, float y)
+{
+	return x < 8.0f || y < 8.0f || x > Map_Width() * TILE_SIZE - 8.0f || y > Map_Height() * TILE_SIZE - 8.0f;
+}
+
+// --------------------------------------------------------------------------------
+// Benchmarks
+
+static void PrintResult(const char *name, int numbodies, int numframes, unsigned int msecs)
+{
+	if (!msecs)
+		msecs = 1;
+
+	double steps = (double)numbodies * numframes;
+	printf("%-20s %10.0f body-steps/sec  (%i bodies x %i frames in %u msecs)\n",
+		name, steps * 1000.0 / msecs, numbodies, numframes, msecs);
+}
+
+
+
+static unsigned int Bench_Scalar(body_t *bodies, int numbodies, int numframes)
+{
+	unsigned int starttime = Sys_Milliseconds();
+
+	for (unsigned int frame = 1; frame <= (unsigned int)numframes; frame++)
+	{
+		for (int i = 0; i < numbodies; i++)
+		{
+			bodies[i].cmd = BodyCommand(i, frame);
+			Body_Step(bodies[i], frame);
+
+			if (OutsideMap((float)bodies[i].objx, (float)bodies[i].objy))
+				SpawnBody(bodies[i], i);
+		}
+	}
+
+	return Sys_Milliseconds() - starttime;
+}
+
+
+
+static unsigned int Bench_Batch(bodybatch_t &batch, int numframes)
+{
+	unsigned int starttime = Sys_Milliseconds();
+
+	for (unsigned int frame = 1; frame <= (unsigned int)numframes; frame++)
+	{
+		for (int i = 0; i < batch.numbodies; i++)
+			Batch_SetCommand(batch, i, BodyCommand(i, frame));
+
+		Batch_Step(batch, frame);
+
+		for (int i = 0; i < batch.numbodies; i++)
+		{
+			if (OutsideMap((float)batch.objx[i], (float)batch.objy[i]))
+			{
+				body_t body;
+				SpawnBody(body, i);
+				Batch_SetBody(batch, i, body);
+			}
+		}
+	}
+
+	return Sys_Milliseconds() - starttime;
+}
+
+// --------------------------------------------------------------------------------
+// Crowds
+//
+// Every spawn holds a stack of bodies, so the bodies collide with each other
+// from the first frame. The grid broadphase is timed against testing every
+// pair, both must push the bodies the same way.
+
+static unsigned int Bench_Collide(bodybatch_t &batch, int numframes, bool brute, double &pairs)
+{
+	unsigned int starttime = Sys_Milliseconds();
+	pairs = 0;
+
+	for (unsigned int frame = 1; frame <= (unsigned int)numframes; frame++)
+	{
+		for (int i = 0; i < batch.numbodies; i++)
+			Batch_SetCommand(batch, i, BodyCommand(i, frame));
+
+		Batch_Step(batch, frame);
+		pairs += Batch_Collide(batch, brute);
+
+		for (int i = 0; i < batch.numbodies; i++)
+		{
+			if (OutsideMap((float)batch.objx[i], (float)batch.objy[i]))
+			{
+				body_t body;
+				SpawnBody(body, i);
+				Batch_SetBody(batch, i, body);
+			}
+		}
+	}
+
+	return Sys_Milliseconds() - starttime;
+}
+
+// --------------------------------------------------------------------------------
+// Tunnelling
+//
+// Bodies are launched from the spawns in SWEEP_DIRS directions with the clamps
+// raised, their velocity forced every frame. Within a frame a body only ever
+// moves away from where it started on each axis, so it tunnelled if no path of
+// open tiles, monotone on both axes, links the tiles its centre moved between.
+
+#define SWEEP_DIRS		16
+#define SWEEP_FRAMES	16
+#define SWEEP_SPAN		16
+
+static const float sweepspeeds[] = { 8, 16, 24, 32, 48, 64 };
+
+static bool PathBlocked(float x0, float y0, float x1, float y1)
+{
+	int c0 = (int)floorf(x0 / TILE_SIZE);
+	int r0 = (int)floorf(y0 / TILE_SIZE);
+	int c1 = (int)floorf(x1 / TILE_SIZE);
+	int r1 = (int)floorf(y1 / TILE_SIZE);
+
+	int w = abs(c1 - c0) + 1;
+	int h = abs(r1 - r0) + 1;
+	int stepx = c1 >= c0 ? 1 : -1;
+	int stepy = r1 >= r0 ? 1 : -1;
+
+	if (w > SWEEP_SPAN || h > SWEEP_SPAN)
+		return true;
+
+	// reach[j][i] is set when tile i, j is open and reachable from the start
+	bool reach[SWEEP_SPAN][SWEEP_SPAN];
+
+	for (int j = 0; j < h; j++)
+	{
+		for (int i = 0; i < w; i++)
+		{
+			float x = (c0 + i * stepx) * TILE_SIZE + TILE_SIZE / 2;
+			float y = (r0 + j * stepy) * TILE_SIZE + TILE_SIZE / 2;
+			bool open = !(Map_Tile(x, y) & SOLID);
+
+			reach[j][i] = open && ((!i && !j) || (i && reach[j][i - 1]) || (j && reach[j - 1][i]));
+		}
+	}
+
+	return !reach[h - 1][w - 1];
+}
+
+
+
+static void LaunchVelocity(int i, float speed, float &vx, float &vy)
+{
+	float angle = (i % SWEEP_DIRS) * (float)(2.0 * M_PI / SWEEP_DIRS);
+	vx = speed * cosf(angle);
+	vy = speed * sinf(angle);
+}
+
+
+
+static int Sweep_Scalar(body_t *bodies, int numbodies, float speed)
+{
+	int tunnels = 0;
+
+	for (int i = 0; i < numbodies; i++)
+	{
+		float vx, vy;
+		LaunchVelocity(i, speed, vx, vy);
+		SpawnBody(bodies[i], i / SWEEP_DIRS);
+
+		bool tunnelled = false;
+		for (unsigned int frame = 1; frame <= SWEEP_FRAMES; frame++)
+		{
+			float x0 = (float)bodies[i].objx;
+			float y0 = (float)bodies[i].objy;
+
+			bodies[i].velx = vx;
+			bodies[i].vely = vy;
+			Body_Step(bodies[i], frame);
+
+			tunnelled |= PathBlocked(x0, y0, (float)bodies[i].objx, (float)bodies[i].objy);
+		}
+
+		if (tunnelled)
+			tunnels++;
+	}
+
+	return tunnels;
+}
+
+
+
+static void Sweep_Batch(bodybatch_t &batch, int numbodies, float speed)
+{
+	batch.numbodies = 0;
+	for (int i = 0; i < numbodies; i++)
+	{
+		body_t body;
+		SpawnBody(body, i / SWEEP_DIRS);
+		Batch_AddBody(batch, body);
+	}
+
+	for (unsigned int frame = 1; frame <= SWEEP_FRAMES; frame++)
+	{
+		for (int i = 0; i < numbodies; i++)
+		{
+			float vx, vy;
+			LaunchVelocity(i, speed, vx, vy);
+			batch.velx[i] = vx;
+			batch.vely[i] = vy;
+		}
+
+		Batch_Step(batch, frame);
+	}
+}
+
+
+
+static int CompareBodies(const bodybatch_t &batch, const body_t *bodies, int numbodies)
+{
+	int mismatches = 0;
+
+	for (int i = 0; i < numbodies; i++)
+	{
+		body_t body;
+		Batch_GetBody(batch, i, body);
+
+		if (body.objx != bodies[i].objx || body.objy != bodies[i].objy ||
+			body.velx != bodies[i].velx || body.vely != bodies[i].vely ||
+			body.onground != bodies[i].onground || body.ladderstate != bodies[i].ladderstate)
+			mismatches++;
+	}
+
+	return mismatches;
+}
+
+
+
+// returns the number of failures: tunnels with the sweep on and bodies the
+// batch path moved differently
+static int Bench_Sweep(int maxbodies)
+{
+	int numbodies = numspawns * SWEEP_DIRS;
+	if (numbodies > maxbodies)
+		numbodies = maxbodies;
+
+	body_t *bodies = (body_t*)malloc(numbodies * sizeof(body_t));
+	bodybatch_t batch;
+	Batch_Alloc(batch, numbodies);
+
+	int failures = 0;
+
+	for (unsigned int s = 0; s < sizeof(sweepspeeds) / sizeof(sweepspeeds[0]); s++)
+	{
+		float speed = sweepspeeds[s];
+		Sim_SetSpeedLimits(speed + 1.0f, speed + 1.0f, speed + 1.0f);
+
+		Sim_SetSweep(false);
+		int unswept = Sweep_Scalar(bodies, numbodies, speed);
+
+		Sim_SetSweep(true);
+		int tunnels = Sweep_Scalar(bodies, numbodies, speed);
+		Sweep_Batch(batch, numbodies, speed);
+		int mismatches = CompareBodies(batch, bodies, numbodies);
+
+		printf("speed %2.0f  %5i bodies  %5i tunnelled  (%i unswept)  %i batch mismatches\n",
+			speed, numbodies, tunnels, unswept, mismatches);
+
+		failures += tunnels + mismatches;
+	}
+
+	Sim_SetSpeedLimits(5.0f, 2.0f, 10.0f);
+
+	Batch_Free(batch);
+	free(bodies);
+
+	return failures;
+}
+
+// --------------------------------------------------------------------------------
+// Suite
+//
+// -suite times the physics hot path at two levels, each over -runs runs, and
+// prints one csv row per benchmark with the mean, standard deviation and
+// range of the runs. The microbenchmarks call a single function over body
+// states sampled from a crowd moving on the map. The scenarios step one
+// player through a scripted sequence on the built in map, and also report
+// the share of frames spent in or on the tiles the scenario is about.
+
+#define SUITE_SAMPLES		4096
+#define SUITE_MICRO_PASSES	64
+#define SUITE_FRAMES		20000
+
+struct suiteresult_t
+{
+	double	mean, stddev;
+	double	min, max;
+};
+
+static void Suite_Stats(const double *runs, int numruns, suiteresult_t &result)
+{
+	result.mean = 0.0;
+	result.min = runs[0];
+	result.max = runs[0];
+	for (int i = 0; i < numruns; i++)
+	{
+		result.mean += runs[i];
+		if (runs[i] < result.min)
+			result.min = runs[i];
+		if (runs[i] > result.max)
+			result.max = runs[i];
+	}
+	result.mean /= numruns;
+
+	double sum = 0.0;
+	for (int i = 0; i < numruns; i++)
+		sum += (runs[i] - result.mean) * (runs[i] - result.mean);
+	result.stddev = numruns > 1 ? sqrt(sum / (numruns - 1)) : 0.0;
+}
+
+
+
+// coverage below 0 isn't printed
+static void Suite_Print(const char *name, const char *unit, const double *runs, int numruns, double coverage)
+{
+	suiteresult_t result;
+	Suite_Stats(runs, numruns, result);
+
+	printf("%s,%s,%s,%i,%.3f,%.3f,%.3f,%.3f,", name, VEC_NAME, unit, numruns,
+		result.mean, result.stddev, result.min, result.max);
+	if (coverage >= 0.0)
+		printf("%.3f", coverage);
+	printf("\n");
+}
+
+//
+// Microbenchmarks
+//
+
+// states of a moving crowd, each with a move to the position it's heading for
+static body_t samples[SUITE_SAMPLES];
+
+// the ones whose move ends in a wall, with their solid clip code
+static body_t clipsamples[SUITE_SAMPLES];
+static int clipcodes[SUITE_SAMPLES];
+static int numclipsamples;
+
+// keeps the results of the timed calls alive
+static volatile int suitesink;
+
+static void Suite_InitSamples()
+{
+	for (int i = 0; i < SUITE_SAMPLES; i++)
+		SpawnBody(samples[i], i);
+
+	// sample bodies at different frames, so the states mix running, falling
+	// and resting
+	numclipsamples = 0;
+	for (unsigned int frame = 1; frame <= 64; frame++)
+	{
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+		{
+			body_t &body = samples[i];
+
+			body.cmd = BodyCommand(i, frame);
+			Body_Step(body, frame);
+			if (OutsideMap((float)body.objx, (float)body.objy))
+				SpawnBody(body, i);
+		}
+	}
+
+	for (int i = 0; i < SUITE_SAMPLES; i++)
+	{
+		body_t &body = samples[i];
+		body.nextx = body.objx + body.velx;
+		body.nexty = body.objy + body.vely - 1.0f;
+
+		int code = Move_ClipCode(body, SOLID);
+		if (code)
+		{
+			clipsamples[numclipsamples] = body;
+			clipcodes[numclipsamples] = code;
+			numclipsamples++;
+		}
+	}
+}
+
+
+
+static void Micro_MapTile(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+			sink += Map_Tile(samples[i].nextx, samples[i].nexty);
+
+	suitesink = sink;
+}
+
+
+
+static void Micro_MapTileType(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+			sink += Map_TileType(samples[i].nextx, samples[i].nexty);
+
+	suitesink = sink;
+}
+
+
+
+static void Micro_MapSolid(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+			sink += Map_Solid(samples[i], samples[i].nextx - 4.0f, samples[i].nexty - 4.0f);
+
+	suitesink = sink;
+}
+
+
+
+static void Micro_MoveClipCode(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+			sink += Move_ClipCode(samples[i], SOLID);
+
+	suitesink = sink;
+}
+
+
+
+// the clip changes the body, so every call works on a copy
+static void Micro_MoveClipSolid(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+	{
+		for (int i = 0; i < numclipsamples; i++)
+		{
+			body_t body = clipsamples[i];
+			Move_Clip_Solid(body, clipcodes[i]);
+			sink += body.velx == 0.0f;
+		}
+	}
+
+	suitesink = sink;
+}
+
+
+
+static void Micro_MoveOnGround(int passes)
+{
+	int sink = 0;
+
+	for (int pass = 0; pass < passes; pass++)
+		for (int i = 0; i < SUITE_SAMPLES; i++)
+			sink += Move_OnGround(samples[i]);
+
+	suitesink = sink;
+}
+
+struct microbench_t
+{
+	const char	*name;
+	void		(*run)(int passes);
+	bool		clipsamples;		// runs over the colliding samples only
+};
+
+static const microbench_t microbenches[] =
+{
+	{ "micro/Map_Tile",				Micro_MapTile,		false },
+	{ "micro/Map_TileType",			Micro_MapTileType,	false },
+	{ "micro/Map_Solid",			Micro_MapSolid,		false },
+	{ "micro/Move_ClipCode",		Micro_MoveClipCode,	false },
+	{ "micro/Move_Clip_Solid",		Micro_MoveClipSolid,	true },
+	{ "micro/Move_OnGround",		Micro_MoveOnGround,	false },
+};
+
+//
+// Scenarios
+//
+
+struct scenariostep_t
+{
+	int			frames;
+	const char	*keys;			// glut bindings, a d w s x z
+};
+
+struct scenario_t
+{
+	const char				*name;
+	float					x, y;		// start
+	int						contents;	// tiles the scenario is about
+	const scenariostep_t	*steps;		// looped, ends with 0 frames
+};
+
+// back and forth along the floor above the water
+static const scenariostep_t runsteps[] = { { 30, "d" }, { 30, "a" }, { 15, "dz" }, { 15, "az" }, { 0, NULL } };
+// jumps up through a one way tile onto it and walks off the end
+static const scenariostep_t jumpsteps[] = { { 12, "x" }, { 24, "." }, { 30, "a" }, { 7, "d" }, { 20, "." }, { 0, NULL } };
+// up and down the ladder through the floor it crosses
+static const scenariostep_t laddersteps[] = { { 60, "w" }, { 60, "s" }, { 0, NULL } };
+// strokes across the water
+static const scenariostep_t swimsteps[] = { { 6, "x" }, { 10, "d" }, { 6, "dx" }, { 10, "." }, { 6, "ax" }, { 10, "a" }, { 0, NULL } };
+// jumps into the field up the right wall and rides it, then steps off onto
+// the ledge or the floor
+static const scenariostep_t fieldsteps[] = { { 12, "dx" }, { 40, "." }, { 10, "a" }, { 30, "." }, { 0, NULL } };
+
+static const scenario_t scenarios[] =
+{
+	{ "scenario/run",		40.0f,	72.0f,	SOLID,		runsteps },
+	{ "scenario/oneway",	40.0f,	72.0f,	ONEWAY,		jumpsteps },
+	{ "scenario/ladder",	120.0f,	152.0f,	LADDER,		laddersteps },
+	{ "scenario/swim",		56.0f,	32.0f,	WATER,		swimsteps },
+	{ "scenario/field",		232.0f,	68.0f,	FIELD,		fieldsteps },
+};
+
+static void Scenario_Command(const char *keys, usercmd_t &cmd)
+{
+	bool down[NUM_KEY_ACTIONS];
+
+	memset(down, 0, sizeof(down));
+	for (const char *c = keys; *c; c++)
+	{
+		if (*c == 'a')
+			down[ka_left] = true;
+		else if (*c == 'd')
+			down[ka_right] = true;
+		else if (*c == 'w')
+			down[ka_up] = true;
+		else if (*c == 's')
+			down[ka_down] = true;
+		else if (*c == 'x')
+			down[ka_x] = true;
+		else if (*c == 'z')
+			down[ka_y] = true;
+	}
+
+	BuildMoveCommand(cmd, down);
+}
+
+
+
+// the scripted commands for every frame, built ahead of the timed runs
+static int Scenario_Commands(const scenario_t &scenario, usercmd_t *cmds, int numframes)
+{
+	int step = 0;
+	int stepframes = 0;
+
+	for (int i = 0; i < numframes; i++)
+	{
+		if (stepframes == scenario.steps[step].frames)
+		{
+			step++;
+			if (!scenario.steps[step].frames)
+				step = 0;
+			stepframes = 0;
+		}
+
+		Scenario_Command(scenario.steps[step].keys, cmds[i]);
+		stepframes++;
+	}
+
+	return numframes;
+}
+
+
+
+// nsecs for numframes frames, and the share of them in or standing on the
+// scenario's tiles when coverage is given
+static uint64_t Scenario_Run(const scenario_t &scenario, const usercmd_t *cmds, int numframes, double *coverage)
+{
+	static world_t world;
+	World_Init(world);
+
+	body_t &body = world.player;
+	body.objx = body.nextx = body.prevx = scenario.x;
+	body.objy = body.nexty = body.prevy = scenario.y;
+
+	int covered = 0;
+	uint64_t start = Sys_Nanoseconds();
+
+	for (int i = 0; i < numframes; i++)
+	{
+		SimRunFrame(world, cmds[i]);
+
+		// a box resting on a tile is inside it by the clip slop
+		if (coverage && Map_OnContents(body.objx, body.objy, scenario.contents))
+			covered++;
+	}
+
+	uint64_t nsecs = Sys_Nanoseconds() - start;
+	if (coverage)
+		*coverage = (double)covered / numframes;
+
+	return nsecs;
+}
+
+
+
+static void Bench_Suite(int numruns)
+{
+	double *runs = (double*)malloc(numruns * sizeof(double));
+
+	Suite_InitSamples();
+
+	printf("benchmark,vec,unit,runs,mean,stddev,min,max,coverage\n");
+
+	for (const microbench_t &bench : microbenches)
+	{
+		int calls = (bench.clipsamples ? numclipsamples : SUITE_SAMPLES) * SUITE_MICRO_PASSES;
+
+		// one untimed pass to warm the caches
+		bench.run(1);
+
+		for (int run = 0; run < numruns; run++)
+		{
+			uint64_t t = Sys_Nanoseconds();
+			bench.run(SUITE_MICRO_PASSES);
+			runs[run] = (double)(Sys_Nanoseconds() - t) / calls;
+		}
+
+		Suite_Print(bench.name, "ns/call", runs, numruns, -1.0);
+	}
+
+	usercmd_t *cmds = (usercmd_t*)malloc(SUITE_FRAMES * sizeof(usercmd_t));
+
+	for (const scenario_t &scenario : scenarios)
+	{
+		Scenario_Commands(scenario, cmds, SUITE_FRAMES);
+
+		// the untimed run measures the coverage
+		double coverage;
+		Scenario_Run(scenario, cmds, SUITE_FRAMES, &coverage);
+
+		for (int run = 0; run < numruns; run++)
+			runs[run] = (double)Scenario_Run(scenario, cmds, SUITE_FRAMES, NULL) / SUITE_FRAMES;
+
+		Suite_Print(scenario.name, "ns/frame", runs, numruns, coverage);
+	}
+
+	free(cmds);
+	free(runs);
+}
+
+// --------------------------------------------------------------------------------
+// Main
+
+static void Usage()
+{
+	fprintf(stderr, "usage: bench [-bodies n] [-frames n] [-kernels avx2|sse|scalar] [-map file] [-chunks poolsize] [-sweep] [-collide]\n"
+		"             [-suite] [-runs n]\n");
+	exit(1);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	int numbodies = 4096;
+	int numframes = 1000;
+	const char *mapname = NULL;
+	int chunkpool = 0;
+	bool sweep = false;
+	bool collide = false;
+	bool suite = false;
+	int numruns = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-bodies") && i + 1 < argc)
+			numbodies = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			numframes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-map") && i + 1 < argc)
+			mapname = argv[++i];
+		else if (!strcmp(argv[i], "-chunks") && i + 1 < argc)
+			chunkpool = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-sweep"))
+			sweep = true;
+		else if (!strcmp(argv[i], "-collide"))
+			collide = true;
+		else if (!strcmp(argv[i], "-suite"))
+			suite = true;
+		else if (!strcmp(argv[i], "-runs") && i + 1 < argc)
+			numruns = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-kernels") && i + 1 < argc)
+		{
+			if (!Sim_SetKernels(argv[++i]))
+			{
+				fprintf(stderr, "kernels %s not supported\n", argv[i]);
+				return 1;
+			}
+		}
+		else
+			Usage();
+	}
+
+	if (numbodies <= 0 || numframes <= 0 || numruns <= 0)
+		Usage();
+
+	// the scenarios are laid out on the built in map
+	if (suite && mapname)
+	{
+		fprintf(stderr, "-suite runs on the built in map\n");
+		return 1;
+	}
+
+	Map_Init();
+	// -chunks streams the map through a pool of resident chunks
+	if (mapname && !(chunkpool ? Map_LoadChunked(mapname, chunkpool) : Map_Load(mapname)))
+		return 1;
+
+	InitCommands();
+	InitSpawns();
+
+	// -sweep checks the swept movement at speeds up to 64 units per frame
+	// instead of timing
+	if (sweep)
+		return Bench_Sweep(numbodies) ? 1 : 0;
+
+	// -suite prints the micro and scenario benchmarks as csv
+	if (suite)
+	{
+		Bench_Suite(numruns);
+		return 0;
+	}
+
+	body_t *bodies = (body_t*)malloc(numbodies * sizeof(body_t));
+	bodybatch_t batch;
+	Batch_Alloc(batch, numbodies);
+
+	for (int i = 0; i < numbodies; i++)
+	{
+		SpawnBody(bodies[i], i);
+		Batch_AddBody(batch, bodies[i]);
+	}
+
+	// -collide times the body collision instead, with the batch path as the
+	// reference
+	if (collide)
+	{
+		bodybatch_t brutebatch;
+		Batch_Alloc(brutebatch, numbodies);
+		for (int i = 0; i < numbodies; i++)
+			Batch_AddBody(brutebatch, bodies[i]);
+
+		double gridpairs, brutepairs;
+		unsigned int gridtime = Bench_Collide(batch, numframes, false, gridpairs);
+		unsigned int brutetime = Bench_Collide(brutebatch, numframes, true, brutepairs);
+
+		PrintResult("collide/grid/" VEC_NAME, numbodies, numframes, gridtime);
+		PrintResult("collide/brute/" VEC_NAME, numbodies, numframes, brutetime);
+		printf("%.1f pairs per frame\n", gridpairs / numframes);
+
+		for (int i = 0; i < numbodies; i++)
+			Batch_GetBody(brutebatch, i, bodies[i]);
+		Batch_Free(brutebatch);
+	}
+	else
+	{
+		unsigned int scalartime = Bench_Scalar(bodies, numbodies, numframes);
+		unsigned int batchtime = Bench_Batch(batch, numframes);
+
+		char batchname[32];
+		snprintf(batchname, sizeof(batchname), "batch/%s/%s", Sim_KernelName(), VEC_NAME);
+
+		PrintResult("scalar/" VEC_NAME, numbodies, numframes, scalartime);
+		PrintResult(batchname, numbodies, numframes, batchtime);
+	}
+
+	// both paths must produce identical bodies
+	int mismatches = CompareBodies(batch, bodies, numbodies);
+
+	if (mismatches)
+		printf("warning: %i bodies differ between the %s paths\n", mismatches, collide ? "grid and brute" : "scalar and batch");
+
+	Batch_Free(batch);
+	free(bodies);
+
+	return mismatches ? 1 : 0;
+}
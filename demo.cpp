@@ -0,0 +1,131 @@
+#include <string.h>
+#include "demo.h"
+
+// --------------------------------------------------------------------------------
+// Command packing
+
+static int Demo_PackAxis(float move)
+{
+	if (move > 0)
+		return 1;
+	if (move < 0)
+		return 2;
+	return 0;
+}
+
+
+
+unsigned char Demo_PackCommand(const usercmd_t &cmd)
+{
+	unsigned char c = 0;
+
+	c |= Demo_PackAxis(cmd.movex) << DEMO_MOVEX_SHIFT;
+	c |= Demo_PackAxis(cmd.movey) << DEMO_MOVEY_SHIFT;
+	if (cmd.buttonx)
+		c |= DEMO_BUTTONX;
+	if (cmd.buttonz)
+		c |= DEMO_BUTTONZ;
+
+	return c;
+}
+
+
+
+void Demo_UnpackCommand(unsigned char c, usercmd_t &cmd)
+{
+	static const float axis[4] = { 0, 1, -1, 0 };
+
+	cmd.movex = axis[(c >> DEMO_MOVEX_SHIFT) & 3];
+	cmd.movey = axis[(c >> DEMO_MOVEY_SHIFT) & 3];
+	cmd.buttonx = (c & DEMO_BUTTONX) != 0;
+	cmd.buttonz = (c & DEMO_BUTTONZ) != 0;
+}
+
+// --------------------------------------------------------------------------------
+// Files
+
+bool Demo_OpenWrite(demo_t &demo, const char *filename, unsigned int simframe)
+{
+	memset(&demo, 0, sizeof(demo));
+
+	demo.fp = fopen(filename, "wb");
+	if (!demo.fp)
+	{
+		fprintf(stderr, "demo: couldn't open %s\n", filename);
+		return false;
+	}
+
+	setvbuf(demo.fp, NULL, _IOFBF, DEMO_BUFFER);
+
+	demoheader_t header;
+	memcpy(header.magic, DEMO_MAGIC, sizeof(header.magic));
+	header.simframe = simframe;
+	fwrite(&header, sizeof(header), 1, demo.fp);
+
+	demo.writing = true;
+	demo.simframe = simframe;
+
+	return true;
+}
+
+
+
+bool Demo_OpenRead(demo_t &demo, const char *filename)
+{
+	memset(&demo, 0, sizeof(demo));
+
+	demo.fp = fopen(filename, "rb");
+	if (!demo.fp)
+	{
+		fprintf(stderr, "demo: couldn't open %s\n", filename);
+		return false;
+	}
+
+	demoheader_t header;
+	if (fread(&header, sizeof(header), 1, demo.fp) != 1 || memcmp(header.magic, DEMO_MAGIC, sizeof(header.magic)))
+	{
+		fprintf(stderr, "demo: %s is not a demo\n", filename);
+		fclose(demo.fp);
+		demo.fp = NULL;
+		return false;
+	}
+
+	demo.simframe = header.simframe;
+
+	return true;
+}
+
+
+
+void Demo_Close(demo_t &demo)
+{
+	if (demo.fp)
+		fclose(demo.fp);
+	demo.fp = NULL;
+}
+
+
+
+void Demo_WriteCommand(demo_t &demo, const usercmd_t &cmd)
+{
+	putc(Demo_PackCommand(cmd), demo.fp);
+	demo.simframe++;
+}
+
+
+
+bool Demo_ReadCommand(demo_t &demo, usercmd_t &cmd)
+{
+	if (demo.bufferpos == demo.bufferlen)
+	{
+		demo.bufferlen = fread(demo.buffer, 1, sizeof(demo.buffer), demo.fp);
+		demo.bufferpos = 0;
+		if (!demo.bufferlen)
+			return false;
+	}
+
+	Demo_UnpackCommand(demo.buffer[demo.bufferpos++], cmd);
+	demo.simframe++;
+
+	return true;
+}
@@ -0,0 +1,50 @@
+#ifndef DEMO_H
+#define DEMO_H
+
+#include <stdio.h>
+#include "sim.h"
+
+// --------------------------------------------------------------------------------
+// Input logs
+//
+// A demo is a small header followed by one byte per sim frame holding the
+// frame's move command. Replaying the commands from World_Init reproduces
+// the recorded session exactly.
+
+#define DEMO_MAGIC		"PFD1"
+#define DEMO_BUFFER		65536
+
+// command byte layout
+#define DEMO_MOVEX_SHIFT	0	// 2 bits, 0 none, 1 positive, 2 negative
+#define DEMO_MOVEY_SHIFT	2
+#define DEMO_BUTTONX		16
+#define DEMO_BUTTONZ		32
+
+struct demoheader_t
+{
+	char			magic[4];
+	unsigned int	simframe;		// simframe of the first command
+};
+
+struct demo_t
+{
+	FILE			*fp;
+	bool			writing;
+	unsigned int	simframe;		// simframe of the next command
+
+	// read buffer, the FILE buffers the writes
+	unsigned char	buffer[DEMO_BUFFER];
+	int				bufferpos, bufferlen;
+};
+
+unsigned char Demo_PackCommand(const usercmd_t &cmd);
+void Demo_UnpackCommand(unsigned char c, usercmd_t &cmd);
+
+bool Demo_OpenWrite(demo_t &demo, const char *filename, unsigned int simframe);
+bool Demo_OpenRead(demo_t &demo, const char *filename);
+void Demo_Close(demo_t &demo);
+
+void Demo_WriteCommand(demo_t &demo, const usercmd_t &cmd);
+bool Demo_ReadCommand(demo_t &demo, usercmd_t &cmd);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+// 16.16 fixed point scalar, used as vec_t when the simulation is built with
+// SIM_FIXED. All the arithmetic is integer so results are bit exact across
+// compilers, flags and machines. Positions must stay within +-32767.
+
+#define FIXED_SHIFT	16
+#define FIXED_ONE	(1 << FIXED_SHIFT)
+
+struct fixed_t
+{
+	int32_t	raw;
+
+	fixed_t() = default;
+	constexpr fixed_t(int i) : raw(i * FIXED_ONE) {}
+	constexpr fixed_t(float f) : raw((int32_t)(f * FIXED_ONE + (f < 0.0f ? -0.5f : 0.5f))) {}
+	constexpr fixed_t(double d) : raw((int32_t)(d * FIXED_ONE + (d < 0.0 ? -0.5 : 0.5))) {}
+
+	static constexpr fixed_t FromRaw(int32_t r) { return fixed_t(r, 0); }
+
+	explicit operator float() const { return raw * (1.0f / FIXED_ONE); }
+
+	fixed_t &operator+=(fixed_t b) { raw += b.raw; return *this; }
+	fixed_t &operator-=(fixed_t b) { raw -= b.raw; return *this; }
+	fixed_t &operator*=(fixed_t b) { raw = (int32_t)(((int64_t)raw * b.raw) >> FIXED_SHIFT); return *this; }
+
+private:
+	constexpr fixed_t(int32_t r, int) : raw(r) {}
+};
+
+inline fixed_t operator+(fixed_t a, fixed_t b) { return fixed_t::FromRaw(a.raw + b.raw); }
+inline fixed_t operator-(fixed_t a, fixed_t b) { return fixed_t::FromRaw(a.raw - b.raw); }
+inline fixed_t operator-(fixed_t a) { return fixed_t::FromRaw(-a.raw); }
+inline fixed_t operator*(fixed_t a, fixed_t b) { return fixed_t::FromRaw((int32_t)(((int64_t)a.raw * b.raw) >> FIXED_SHIFT)); }
+inline fixed_t operator/(fixed_t a, fixed_t b) { return fixed_t::FromRaw((int32_t)(((int64_t)a.raw << FIXED_SHIFT) / b.raw)); }
+
+inline bool operator==(fixed_t a, fixed_t b) { return a.raw == b.raw; }
+inline bool operator!=(fixed_t a, fixed_t b) { return a.raw != b.raw; }
+inline bool operator<(fixed_t a, fixed_t b) { return a.raw < b.raw; }
+inline bool operator<=(fixed_t a, fixed_t b) { return a.raw <= b.raw; }
+inline bool operator>(fixed_t a, fixed_t b) { return a.raw > b.raw; }
+inline bool operator>=(fixed_t a, fixed_t b) { return a.raw >= b.raw; }
+
+inline fixed_t fabs(fixed_t a) { return fixed_t::FromRaw(a.raw < 0 ? -a.raw : a.raw); }
+
+#endif
@@ -0,0 +1,599 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include "sys.h"
+#include "sim.h"
+#include "demo.h"
+#include "rollback.h"
+#include "prof.h"
+#include "r_soft.h"
+
+// --------------------------------------------------------------------------------
+// Scripted input
+//
+// A script is a list of lines of the form "<frames> <keys>", holding the keys
+// down for the given number of sim frames. Keys use the same bindings as the
+// glut frontend (a d w s x z) and '.' means no keys. Lines starting with '#'
+// are comments. The script loops until the requested frame count is reached.
+
+#define MAX_SCRIPT_STEPS	1024
+
+struct scriptstep_t
+{
+	int		frames;
+	bool	keys[NUM_KEY_ACTIONS];
+};
+
+static scriptstep_t script[MAX_SCRIPT_STEPS];
+static int numscriptsteps;
+
+// run right, jump onto the one way tiles, drop down and climb the ladder
+static const char defaultscript[] =
+	"20 d\n"
+	"10 dx\n"
+	"30 d\n"
+	"20 a\n"
+	"10 ax\n"
+	"40 .\n"
+	"40 w\n"
+	"30 s\n"
+	"20 dz\n";
+
+static bool Script_ParseLine(const char *line, scriptstep_t *step)
+{
+	char keys[64];
+
+	if (sscanf(line, "%i %63s", &step->frames, keys) != 2 || step->frames <= 0)
+		return false;
+
+	memset(step->keys, 0, sizeof(step->keys));
+	for (const char *c = keys; *c; c++)
+	{
+		if (*c == 'a')
+			step->keys[ka_left] = true;
+		else if (*c == 'd')
+			step->keys[ka_right] = true;
+		else if (*c == 'w')
+			step->keys[ka_up] = true;
+		else if (*c == 's')
+			step->keys[ka_down] = true;
+		else if (*c == 'x')
+			step->keys[ka_x] = true;
+		else if (*c == 'z')
+			step->keys[ka_y] = true;
+		else if (*c != '.')
+			return false;
+	}
+
+	return true;
+}
+
+static bool Script_Parse(const char *text)
+{
+	numscriptsteps = 0;
+
+	while (*text)
+	{
+		char line[256];
+		int len = strcspn(text, "\n");
+		if (len >= (int)sizeof(line))
+			len = sizeof(line) - 1;
+
+		memcpy(line, text, len);
+		line[len] = '\0';
+		text += strcspn(text, "\n");
+		if (*text)
+			text++;
+
+		if (line[strspn(line, " \t\r")] == '\0' || line[0] == '#')
+			continue;
+
+		if (numscriptsteps == MAX_SCRIPT_STEPS)
+		{
+			fprintf(stderr, "script: too many lines\n");
+			return false;
+		}
+
+		if (!Script_ParseLine(line, &script[numscriptsteps]))
+		{
+			fprintf(stderr, "script: bad line \"%s\"\n", line);
+			return false;
+		}
+
+		numscriptsteps++;
+	}
+
+	if (!numscriptsteps)
+	{
+		fprintf(stderr, "script: no input\n");
+		return false;
+	}
+
+	return true;
+}
+
+static bool Script_Load(const char *filename)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "script: couldn't open %s\n", filename);
+		return false;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	char *text = (char*)malloc(size + 1);
+	size = fread(text, 1, size, fp);
+	text[size] = '\0';
+	fclose(fp);
+
+	bool ok = Script_Parse(text);
+	free(text);
+
+	return ok;
+}
+
+
+
+// the next move command from the demo being replayed or the script, false at
+// the end of the demo
+static bool Input_NextCommand(demo_t &replay, usercmd_t &cmd)
+{
+	static int step;
+	static int stepframes;
+
+	if (replay.fp)
+		return Demo_ReadCommand(replay, cmd);
+
+	if (stepframes == script[step].frames)
+	{
+		step = (step + 1) % numscriptsteps;
+		stepframes = 0;
+	}
+
+	BuildMoveCommand(cmd, script[step].keys);
+	stepframes++;
+
+	return true;
+}
+
+// --------------------------------------------------------------------------------
+// Trajectory traces
+//
+// A trace is the player position after every sim frame, one "<x> <y>" line
+// per frame. Traces written by one build can be verified against another,
+// e.g. the fixed point build against the float build, within a tolerance in
+// pixels.
+
+static FILE *tracefile;
+static FILE *verifyfile;
+static float tolerance = 0.5f;
+static float maxdeviation;
+static int maxdeviationframe = -1;
+static int firstfailframe = -1;
+
+static FILE *Trace_Open(const char *filename, const char *mode)
+{
+	FILE *fp = fopen(filename, mode);
+	if (!fp)
+		fprintf(stderr, "trace: couldn't open %s\n", filename);
+	return fp;
+}
+
+static void Trace_Frame(int frame, const body_t &body)
+{
+	float x = (float)body.objx;
+	float y = (float)body.objy;
+
+	if (tracefile)
+		fprintf(tracefile, "%f %f\n", x, y);
+
+	if (verifyfile)
+	{
+		float tx, ty;
+		if (fscanf(verifyfile, "%f %f", &tx, &ty) != 2)
+		{
+			fprintf(stderr, "trace: verify file ends at frame %i\n", frame);
+			fclose(verifyfile);
+			verifyfile = NULL;
+			if (firstfailframe < 0)
+				firstfailframe = frame;
+			return;
+		}
+
+		float deviation = fabsf(x - tx) > fabsf(y - ty) ? fabsf(x - tx) : fabsf(y - ty);
+		if (deviation > maxdeviation)
+		{
+			maxdeviation = deviation;
+			maxdeviationframe = frame;
+		}
+		if (deviation > tolerance && firstfailframe < 0)
+			firstfailframe = frame;
+	}
+}
+
+// --------------------------------------------------------------------------------
+// Collision variants
+//
+// -variants runs the same commands through every collision policy in
+// lockstep, one world each, and reports the first frame where a variant's
+// position differs from the first one. Each is then timed on its own over
+// the same commands, best of VARIANT_PASSES.
+
+#define VARIANT_PASSES	3
+
+struct variant_t
+{
+	const char	*name;
+	const char	*desc;
+	void		(*runframe)(world_t &world, const usercmd_t &cmd);
+};
+
+static const variant_t variants[] =
+{
+	{ "full",	"solid, one way '1' and 'l'",		SimRunFrameWith<collide_full_t> },
+	{ "oneway",	"solid and one way '1'",			SimRunFrameWith<collide_oneway_t> },
+	{ "solid",	"solid only, ground probe at -5, glsim-good's clip",	SimRunFrameWith<collide_solid_t> },
+};
+
+#define NUM_VARIANTS	(int)(sizeof(variants) / sizeof(variants[0]))
+
+static int Variants_Run(demo_t &replay, int numframes)
+{
+	static world_t worlds[NUM_VARIANTS];
+	int diverged[NUM_VARIANTS];
+	int differing[NUM_VARIANTS];			// frames not at the first's position
+	body_t divergedbody[NUM_VARIANTS];		// the variant's and the first's at that frame
+	body_t divergedbase[NUM_VARIANTS];
+	uint64_t best[NUM_VARIANTS];
+
+	for (int v = 0; v < NUM_VARIANTS; v++)
+	{
+		World_Init(worlds[v]);
+		diverged[v] = -1;
+		differing[v] = 0;
+	}
+
+	// the commands are kept for the timed runs
+	int maxcmds = 0;
+	usercmd_t *cmds = NULL;
+	int i;
+	for (i = 0; i < numframes; i++)
+	{
+		if (i == maxcmds)
+		{
+			maxcmds = maxcmds ? maxcmds * 2 : 65536;
+			cmds = (usercmd_t*)realloc(cmds, maxcmds * sizeof(usercmd_t));
+		}
+
+		if (!Input_NextCommand(replay, cmds[i]))
+			break;
+
+		for (int v = 0; v < NUM_VARIANTS; v++)
+			variants[v].runframe(worlds[v], cmds[i]);
+
+		const body_t &base = worlds[0].player;
+		for (int v = 1; v < NUM_VARIANTS; v++)
+		{
+			const body_t &body = worlds[v].player;
+			if (body.objx == base.objx && body.objy == base.objy)
+				continue;
+
+			differing[v]++;
+			if (diverged[v] < 0)
+			{
+				diverged[v] = i;
+				divergedbody[v] = body;
+				divergedbase[v] = base;
+			}
+		}
+	}
+	numframes = i;
+
+	if (!numframes)
+	{
+		free(cmds);
+		return 1;
+	}
+
+	for (int v = 0; v < NUM_VARIANTS; v++)
+	{
+		best[v] = UINT64_MAX;
+
+		for (int pass = 0; pass < VARIANT_PASSES; pass++)
+		{
+			static world_t world;
+			World_Init(world);
+
+			uint64_t t = Sys_Nanoseconds();
+			for (i = 0; i < numframes; i++)
+				variants[v].runframe(world, cmds[i]);
+			t = Sys_Nanoseconds() - t;
+
+			if (t < best[v])
+				best[v] = t;
+		}
+	}
+
+	free(cmds);
+
+	printf("%i frames, %s, differences against %s\n", numframes, VEC_NAME, variants[0].name);
+	printf("%-8s %10s %10s %10s  %s\n", "variant", "ns/frame", "diverges", "differ", "collision");
+	for (int v = 0; v < NUM_VARIANTS; v++)
+	{
+		char frame[16];
+		if (diverged[v] < 0)
+			strcpy(frame, "-");
+		else
+			snprintf(frame, sizeof(frame), "%i", diverged[v]);
+
+		printf("%-8s %10.2f %10s %10i  %s\n", variants[v].name, (double)best[v] / numframes, frame, differing[v], variants[v].desc);
+	}
+
+	for (int v = 1; v < NUM_VARIANTS; v++)
+	{
+		if (diverged[v] >= 0)
+			printf("%s diverges at frame %i: %f, %f against %f, %f\n", variants[v].name, diverged[v],
+				(float)divergedbody[v].objx, (float)divergedbody[v].objy,
+				(float)divergedbase[v].objx, (float)divergedbase[v].objy);
+	}
+
+	return 0;
+}
+
+// --------------------------------------------------------------------------------
+// Main
+
+static void Usage()
+{
+	fprintf(stderr, "usage: headless [-frames n] [-trace file] [-verify file] [-tolerance px]\n"
+		"                [-record demo] [-rollback depth] [-prof] [-ppm file] [-ppmstep n] [-scale n]\n"
+		"                [-map file] [-chunks poolsize] [-writemap file] [-variants]\n"
+		"                [-replay demo | script]\n");
+	exit(1);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	int numframes = 1000000;
+	bool framesset = false;
+	const char *scriptname = NULL;
+	const char *tracename = NULL;
+	const char *verifyname = NULL;
+	const char *recordname = NULL;
+	const char *replayname = NULL;
+	int rollbackdepth = 0;
+	const char *ppmname = NULL;
+	int ppmstep = 1;
+	int scale = 1;
+	const char *mapname = NULL;
+	int chunkpool = 0;
+	const char *writemapname = NULL;
+	bool variantsmode = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+		{
+			numframes = atoi(argv[++i]);
+			framesset = true;
+		}
+		else if (!strcmp(argv[i], "-trace") && i + 1 < argc)
+			tracename = argv[++i];
+		else if (!strcmp(argv[i], "-verify") && i + 1 < argc)
+			verifyname = argv[++i];
+		else if (!strcmp(argv[i], "-tolerance") && i + 1 < argc)
+			tolerance = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-record") && i + 1 < argc)
+			recordname = argv[++i];
+		else if (!strcmp(argv[i], "-replay") && i + 1 < argc)
+			replayname = argv[++i];
+		else if (!strcmp(argv[i], "-rollback") && i + 1 < argc)
+			rollbackdepth = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-prof"))
+			Prof_Enable(true);
+		else if (!strcmp(argv[i], "-ppm") && i + 1 < argc)
+			ppmname = argv[++i];
+		else if (!strcmp(argv[i], "-ppmstep") && i + 1 < argc)
+			ppmstep = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-scale") && i + 1 < argc)
+			scale = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-map") && i + 1 < argc)
+			mapname = argv[++i];
+		else if (!strcmp(argv[i], "-chunks") && i + 1 < argc)
+			chunkpool = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-writemap") && i + 1 < argc)
+			writemapname = argv[++i];
+		else if (!strcmp(argv[i], "-variants"))
+			variantsmode = true;
+		else if (argv[i][0] == '-' || scriptname)
+			Usage();
+		else
+			scriptname = argv[i];
+	}
+
+	if ((replayname && scriptname) || rollbackdepth < 0 || rollbackdepth > ROLLBACK_FRAMES || ppmstep < 1)
+		Usage();
+	// the variants only compare positions
+	if (variantsmode && (tracename || verifyname || recordname || rollbackdepth || ppmname))
+		Usage();
+
+	// a replay runs to the end of the demo unless limited with -frames
+	static demo_t replay;
+	if (replayname)
+	{
+		if (!Demo_OpenRead(replay, replayname))
+			return 1;
+		if (!framesset)
+			numframes = INT_MAX;
+	}
+	else if (scriptname ? !Script_Load(scriptname) : !Script_Parse(defaultscript))
+		return 1;
+
+	if (tracename && !(tracefile = Trace_Open(tracename, "w")))
+		return 1;
+	if (verifyname && !(verifyfile = Trace_Open(verifyname, "r")))
+		return 1;
+	bool verifying = verifyfile != NULL;
+
+	Map_Init();
+	// -chunks streams the map through a pool of resident chunks
+	if (mapname && !(chunkpool ? Map_LoadChunked(mapname, chunkpool) : Map_Load(mapname)))
+		return 1;
+
+	// saves the current map, the built in one unless -map is given
+	if (writemapname)
+		return Map_Write(writemapname) ? 0 : 1;
+
+	static world_t world;
+	World_Init(world);
+
+	if (replay.fp && replay.simframe != world.simframe + 1)
+	{
+		fprintf(stderr, "demo: %s doesn't start at the first frame\n", replayname);
+		return 1;
+	}
+
+	if (variantsmode)
+	{
+		int ret = Variants_Run(replay, numframes);
+		Demo_Close(replay);
+		return ret;
+	}
+
+	static demo_t record;
+	if (recordname && !Demo_OpenWrite(record, recordname, world.simframe + 1))
+		return 1;
+
+	// with -rollback every frame rewinds depth frames and simulates them
+	// again, as if the oldest command had arrived late. The result must be
+	// the same as running without rollback.
+	static rollback_t rollback;
+	Rollback_Init(rollback, world);
+
+	// -ppm renders every ppmstep'th frame with the software renderer and
+	// appends it to a ppm stream
+	static softframe_t softframe;
+	FILE *ppmfile = NULL;
+	int rendered = 0;
+	uint64_t rendertime = 0;
+	if (ppmname)
+	{
+		if (!R_SoftInit(softframe, scale))
+		{
+			fprintf(stderr, "couldn't init the software renderer at scale %i\n", scale);
+			return 1;
+		}
+		if (!(ppmfile = fopen(ppmname, "wb")))
+		{
+			fprintf(stderr, "couldn't open %s\n", ppmname);
+			return 1;
+		}
+	}
+
+	unsigned int starttime = Sys_Milliseconds();
+
+	// run the simulation as fast as possible, building the move commands
+	// from the script the same way the glut frontend does from the keyboard
+	int i;
+	for (i = 0; i < numframes; i++)
+	{
+		usercmd_t cmd;
+
+		if (!Input_NextCommand(replay, cmd))
+			break;
+
+		if (record.fp)
+			Demo_WriteCommand(record, cmd);
+
+		if (rollbackdepth)
+		{
+			Rollback_RunFrame(rollback, world, cmd);
+
+			unsigned int simframe = world.simframe - rollbackdepth + 1;
+			if (Rollback_CanCorrect(rollback, world, simframe))
+				Rollback_Correct(rollback, world, simframe, rollback.cmds[ROLLBACK_SLOT(simframe)]);
+		}
+		else
+			SimRunFrame(world, cmd);
+
+		if (tracefile || verifyfile)
+			Trace_Frame(i, world.player);
+
+		if (ppmfile && !(i % ppmstep))
+		{
+			uint64_t t = Sys_Nanoseconds();
+			R_SoftDrawFrame(softframe, (float)world.player.objx, (float)world.player.objy);
+			rendertime += Sys_Nanoseconds() - t;
+			rendered++;
+
+			if (!R_SoftWritePPM(softframe, ppmfile))
+			{
+				fprintf(stderr, "couldn't write %s\n", ppmname);
+				return 1;
+			}
+		}
+	}
+
+	unsigned int msecs = Sys_Milliseconds() - starttime;
+	if (!msecs)
+		msecs = 1;
+	numframes = i;
+
+	Demo_Close(replay);
+	Demo_Close(record);
+
+	printf("%i frames in %u msecs, %.0f frames/sec, %.0fx real time\n", numframes, msecs,
+		numframes * 1000.0 / msecs, (double)numframes * SIM_TIMESTEP / msecs);
+	if (rollbackdepth)
+		printf("rollback depth %i, %.3f usecs per frame with resimulation, %i byte snapshots\n",
+			rollbackdepth, msecs * 1000.0 / numframes, (int)sizeof(snapshot_t));
+	printf("final position %f, %f (%s)\n", (float)world.player.objx, (float)world.player.objy, VEC_NAME);
+
+	if (ppmfile)
+	{
+		fclose(ppmfile);
+
+		if (rendered)
+			printf("%i %ix%i frames rendered, %.3f usecs per frame\n", rendered,
+				softframe.width, softframe.height, rendertime / 1000.0 / rendered);
+
+		R_SoftShutdown(softframe);
+	}
+
+	if (mapname && chunkpool)
+	{
+		chunkstats_t stats;
+		Map_ChunkStats(stats);
+		printf("chunks: %u lookups, %u cache hits, %u loads, %u prefetched, %u prefetch hits, %u stalls, %u evictions\n",
+			stats.lookups, stats.cachehits, stats.loads, stats.prefetches, stats.prefetchhits, stats.stalls, stats.evictions);
+	}
+
+	if (prof_enabled)
+		Prof_Dump(stdout);
+
+	if (tracefile)
+		fclose(tracefile);
+
+	if (verifying)
+	{
+		if (verifyfile)
+			fclose(verifyfile);
+
+		printf("max deviation %f at frame %i, tolerance %f\n", maxdeviation, maxdeviationframe, tolerance);
+		if (firstfailframe >= 0)
+		{
+			printf("trace diverges at frame %i\n", firstfailframe);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sys.h"
+#include "sim.h"
+#include "pool.h"
+
+// --------------------------------------------------------------------------------
+// Sessions
+//
+// Hosts many independent sessions in one process, stepped by the session pool
+// once per tick. Every session is driven by its own pattern of held keys. With
+// -heavy one session in HEAVY_INTERVAL per tick also resimulates a copy of
+// itself for some frames, standing in for the occasional expensive frame.
+
+#define NUM_CMD_PATTERNS	256
+#define HEAVY_INTERVAL		64
+
+static usercmd_t cmdpatterns[NUM_CMD_PATTERNS];
+
+static world_t *worlds;
+static usercmd_t *cmds;
+static int numsessions;
+
+static int heavyframes;
+static unsigned int tick;
+
+static void InitCommands()
+{
+	unsigned int seed = 1234;
+
+	for (int i = 0; i < NUM_CMD_PATTERNS; i++)
+	{
+		bool keys[NUM_KEY_ACTIONS];
+
+		seed = seed * 1103515245 + 12345;
+		for (int k = 0; k < NUM_KEY_ACTIONS; k++)
+			keys[k] = (seed >> (16 + k)) & 1;
+
+		BuildMoveCommand(cmdpatterns[i], keys);
+	}
+}
+
+// each session holds a pattern for 16 ticks, with sessions out of phase
+static const usercmd_t &SessionCommand(int session, unsigned int frame)
+{
+	return cmdpatterns[(session * 7 + (frame >> 4)) & (NUM_CMD_PATTERNS - 1)];
+}
+
+
+
+static void Session_Task(int session, void *data)
+{
+	SimRunFrame(worlds[session], cmds[session]);
+
+	if (heavyframes && !((session + tick) % HEAVY_INTERVAL))
+	{
+		// the copy is thrown away, only the time counts
+		world_t scratch = worlds[session];
+		for (int i = 0; i < heavyframes; i++)
+			SimRunFrame(scratch, cmds[session]);
+	}
+}
+
+// --------------------------------------------------------------------------------
+// Main
+
+static void Usage()
+{
+	fprintf(stderr, "usage: host [-sessions n] [-workers n] [-frames n] [-heavy frames] [-nosteal]\n"
+		"            [-realtime] [-map file]\n");
+	exit(1);
+}
+
+
+
+int main(int argc, char *argv[])
+{
+	int numworkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int numframes = 1000;
+	bool realtime = false;
+	const char *mapname = NULL;
+
+	numsessions = 1024;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-sessions") && i + 1 < argc)
+			numsessions = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-workers") && i + 1 < argc)
+			numworkers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			numframes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-heavy") && i + 1 < argc)
+			heavyframes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-nosteal"))
+			Pool_SetStealing(false);
+		else if (!strcmp(argv[i], "-realtime"))
+			realtime = true;
+		else if (!strcmp(argv[i], "-map") && i + 1 < argc)
+			mapname = argv[++i];
+		else
+			Usage();
+	}
+
+	if (numsessions <= 0 || numframes <= 0 || heavyframes < 0)
+		Usage();
+	if (numworkers > POOL_MAX_WORKERS)
+		numworkers = POOL_MAX_WORKERS;
+
+	// the map is shared by all the sessions, so it can't be chunked
+	Map_Init();
+	if (mapname && !Map_Load(mapname))
+		return 1;
+
+	if (!Pool_Init(numworkers))
+		return 1;
+
+	InitCommands();
+
+	worlds = (world_t*)malloc(numsessions * sizeof(world_t));
+	cmds = (usercmd_t*)malloc(numsessions * sizeof(usercmd_t));
+	for (int i = 0; i < numsessions; i++)
+		World_Init(worlds[i]);
+
+	// -realtime runs one tick per SIM_TIMESTEP like a server would, otherwise
+	// as fast as the workers go
+	unsigned int starttime = Sys_Milliseconds();
+	unsigned int cpustart = Sys_CpuMilliseconds();
+
+	for (tick = 1; tick <= (unsigned int)numframes; tick++)
+	{
+		for (int i = 0; i < numsessions; i++)
+			cmds[i] = SessionCommand(i, tick);
+
+		Pool_Run(numsessions, Session_Task, NULL);
+
+		if (realtime)
+		{
+			int ahead = (int)(starttime + tick * SIM_TIMESTEP - Sys_Milliseconds());
+			if (ahead > 0)
+				Sys_Sleep(ahead);
+		}
+	}
+
+	unsigned int msecs = Sys_Milliseconds() - starttime;
+	unsigned int cpumsecs = Sys_CpuMilliseconds() - cpustart;
+	if (!msecs)
+		msecs = 1;
+
+	printf("%i sessions x %i ticks on %i workers in %u msecs, %.0f session-steps/sec, %.0f%% cpu\n",
+		numsessions, numframes, numworkers, msecs, (double)numsessions * numframes * 1000.0 / msecs,
+		100.0 * cpumsecs / msecs);
+	Pool_Dump(stdout);
+
+	Pool_Shutdown();
+
+	// the sessions must end up where stepping them one after the other does
+	int mismatches = 0;
+	for (int i = 0; i < numsessions; i++)
+	{
+		static world_t world;
+		World_Init(world);
+
+		for (unsigned int frame = 1; frame <= (unsigned int)numframes; frame++)
+			SimRunFrame(world, SessionCommand(i, frame));
+
+		const body_t &a = world.player;
+		const body_t &b = worlds[i].player;
+		if (a.objx != b.objx || a.objy != b.objy || a.velx != b.velx || a.vely != b.vely ||
+			a.onground != b.onground || a.ladderstate != b.ladderstate || world.simframe != worlds[i].simframe)
+			mismatches++;
+	}
+
+	if (mismatches)
+		printf("warning: %i sessions differ from stepping them serially\n", mismatches);
+
+	free(worlds);
+	free(cmds);
+
+	return mismatches ? 1 : 0;
+}
@@ -1,48 +1,150 @@
-#include <sys/time.h>
-#include <unistd.h>
 #include <GL/freeglut.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <math.h>
-
-// simulation timestep in msecs
-// eqv to 30 frames per second
-#define SIM_TIMESTEP	32
-#define TILE_SIZE	16
+#include <pthread.h>
+#include "sys.h"
+#include "sim.h"
+#include "demo.h"
+#include "prof.h"
+#include "r_soft.h"
+#include "threadbuf.h"
 
 static unsigned int realtime;
-static unsigned int simframe;
-static unsigned int simtime;
+static world_t world;
+static demo_t demo;
 
 // --------------------------------------------------------------------------------
-// Input
+// Frame timing
+//
+// Each wake up runs as many sim frames as it takes for simtime to catch up
+// with realtime, at most maxsteps of them. Past that the remaining frames are
+// dropped by moving the clock base forward, rather than letting the sim fall
+// further behind each wake up.
+//
+// Between wake ups the loop sleeps until the next sim frame or render is due.
+// -spin restores the old behaviour of polling the clock from the idle func.
+// Renders happen up to -maxfps times a second and interpolate the player
+// between sim frames, -nolerp draws the latest sim position instead.
+//
+// -threaded runs the sim frames on their own thread so a slow swap doesn't
+// hold up the physics or the other way around. The window callbacks pass key
+// changes through a queue, and every batch of sim frames publishes a render
+// state the display interpolates from the current clock.
+
+#define DEFAULT_MAX_STEPS	8
+#define DEFAULT_MAX_FPS		60
 
-enum keyaction_t
+struct loopstats_t
 {
-	ka_left,
-	ka_right,
-	ka_up,
-	ka_down,
-	ka_x,
-	ka_y,
-	NUM_KEY_ACTIONS
+	unsigned int	wakeups;
+	unsigned int	frames;
+	unsigned int	caughtup;		// frames run beyond the first in a wake up
+	unsigned int	dropped;		// frames skipped by the max steps guard
 };
 
+static unsigned int maxsteps = DEFAULT_MAX_STEPS;
+static bool spin;
+static unsigned int renderinterval = 1000 / DEFAULT_MAX_FPS;	// msecs, 0 renders only after sim frames
+static bool nolerp;
+static unsigned int lastrender;
+static unsigned int lasttime;
+static unsigned int starttime;
+static unsigned int startcpu;
+static unsigned int droppedtime;
+static loopstats_t loopstats;
+
+static bool threaded;
+static pthread_t simthread;
+static bool simquit;
+static keyqueue_t keyqueue;
+static renderbuffer_t renderbuffer;
+
+// 'p' when threaded: the window thread sets profrequest, the sim thread copies
+// its phases and sets profready, the window thread adds its own and prints
+static profsnapshot_t profsnapshot;
+static bool profrequest;
+static bool profready;
+
+// --------------------------------------------------------------------------------
+// Input
+
 static bool keyactions[NUM_KEY_ACTIONS];
 
+// the window thread's latest key state when threaded. keysdropped is set when
+// the queue was full, the sim thread then takes the whole state from here
+static bool windowkeys[NUM_KEY_ACTIONS];
+static bool keysdropped;
+
+// the sim thread owns keyactions when threaded
+static void KeyEvent(int action, bool down)
+{
+	if (!threaded)
+	{
+		keyactions[action] = down;
+		return;
+	}
+
+	// stored before the push, so it's never older than a queued event
+	__atomic_store_n(&windowkeys[action], down, __ATOMIC_RELAXED);
+
+	if (!KeyQueue_Push(keyqueue, action, down))
+		__atomic_store_n(&keysdropped, true, __ATOMIC_RELEASE);
+}
+
+
+
+// applies the queued key changes, on the sim thread
+static void DrainKeys()
+{
+	keyevent_t event;
+
+	while (KeyQueue_Pop(keyqueue, event))
+		keyactions[event.action] = event.down;
+
+	if (__atomic_exchange_n(&keysdropped, false, __ATOMIC_ACQ_REL))
+	{
+		for (int i = 0; i < NUM_KEY_ACTIONS; i++)
+			keyactions[i] = __atomic_load_n(&windowkeys[i], __ATOMIC_RELAXED);
+	}
+
+	// a dump still waiting to be printed owns the snapshot, the request is
+	// kept until it's printed
+	if (!__atomic_load_n(&profrequest, __ATOMIC_ACQUIRE) || __atomic_load_n(&profready, __ATOMIC_ACQUIRE))
+		return;
+
+	Prof_Snapshot(profsnapshot, PHASE_BUILDCMD, PHASE_MOVEMENT);
+	__atomic_store_n(&profrequest, false, __ATOMIC_RELAXED);
+	__atomic_store_n(&profready, true, __ATOMIC_RELEASE);
+}
+
+
+
 static void KeyDownFunc(unsigned char key, int x, int y)
 {
+	// the sim phases are recorded on the sim thread when threaded
+	if (key == 'p')
+	{
+		if (threaded)
+			__atomic_store_n(&profrequest, true, __ATOMIC_RELEASE);
+		else
+			Prof_Dump(stdout);
+	}
+
 	if (key == 'a')
-		keyactions[ka_left] = true;
+		KeyEvent(ka_left, true);
 	if (key == 'd')
-		keyactions[ka_right] = true;
+		KeyEvent(ka_right, true);
 	if (key == 'w')
-		keyactions[ka_up] = true;
+		KeyEvent(ka_up, true);
 	if (key == 's')
-		keyactions[ka_down] = true;
+		KeyEvent(ka_down, true);
 	if (key == 'x')
-		keyactions[ka_x] = true;
+		KeyEvent(ka_x, true);
 	if (key == 'z')
-		keyactions[ka_y] = true;
+		KeyEvent(ka_y, true);
 }
 
 
@@ -50,17 +152,17 @@ static void KeyDownFunc(unsigned char key, int x, int y)
 static void KeyUpFunc(unsigned char key, int x, int y)
 {
 	if (key == 'a')
-		keyactions[ka_left] = false;
+		KeyEvent(ka_left, false);
 	if (key == 'd')
-		keyactions[ka_right] = false;
+		KeyEvent(ka_right, false);
 	if (key == 'w')
-		keyactions[ka_up] = false;
+		KeyEvent(ka_up, false);
 	if (key == 's')
-		keyactions[ka_down] = false;
+		KeyEvent(ka_down, false);
 	if (key == 'x')
-		keyactions[ka_x] = false;
+		KeyEvent(ka_x, false);
 	if (key == 'z')
-		keyactions[ka_y] = false;
+		KeyEvent(ka_y, false);
 }
 
 
@@ -68,13 +170,13 @@ static void KeyUpFunc(unsigned char key, int x, int y)
 static void SpecialDownFunc(int key, int x, int y)
 {
 	if (key == GLUT_KEY_LEFT)
-		keyactions[ka_left] = true;
+		KeyEvent(ka_left, true);
 	if (key == GLUT_KEY_RIGHT)
-		keyactions[ka_right] = true;
+		KeyEvent(ka_right, true);
 	if (key == GLUT_KEY_UP)
-		keyactions[ka_up] = true;
+		KeyEvent(ka_up, true);
 	if (key == GLUT_KEY_DOWN)
-		keyactions[ka_down] = true;
+		KeyEvent(ka_down, true);
 }
 
 
@@ -82,929 +184,623 @@ static void SpecialDownFunc(int key, int x, int y)
 static void SpecialUpFunc(int key, int x, int y)
 {
 	if (key == GLUT_KEY_LEFT)
-		keyactions[ka_left] = false;
+		KeyEvent(ka_left, false);
 	if (key == GLUT_KEY_RIGHT)
-		keyactions[ka_right] = false;
+		KeyEvent(ka_right, false);
 	if (key == GLUT_KEY_UP)
-		keyactions[ka_up] = false;
+		KeyEvent(ka_up, false);
 	if (key == GLUT_KEY_DOWN)
-		keyactions[ka_down] = false;
+		KeyEvent(ka_down, false);
 }
 
 // --------------------------------------------------------------------------------
-// Move commands
-
-float movex = 0.0f;
-float movey = 0.0f;
-bool buttonx = false;
-bool buttonz = false;
+// Rendering
 
-static void BuildMoveCommand()
+static float *LookupColor(int x, int y)
 {
-	movex = 0;
-	if (keyactions[ka_left])
-		movex -= 1;
-	if (keyactions[ka_right])
-		movex += 1;
-
-	movey = 0;
-	if (keyactions[ka_down])
-		movey -= 1;
-	if (keyactions[ka_up])
-		movey += 1;
-
-	buttonx = keyactions[ka_x];
-	buttonz = keyactions[ka_y];
-}
+	static float colors[6][3] = 
+	{
+		{ 1, 0, 0 },
+		{ 0, 0, 1 },
+		{ 1, 1, 1 },
+		{ 1, 1, 0 },
+		{ 0, 1, 1 },
+		{ 0.5, 0, 0 },
+	};
 
+	return colors[TILE_COLOR(Map_Tile(x, y))];
+}
 
 
-// --------------------------------------------------------------------------------
-// Game logic
-
-// player state
-float prevx, prevy;
-float objx = 32.0f;
-float objy = 128.0f;
-float velx = 0.0f;
-float vely = 0.0f;
-float nextx = 0.0f;
-float nexty = 0.0f;
-int lastjump = 0;
-static bool ladderstate = false;
-static bool onground = false;
 
-//
-// Map
-// 
-
-#define LEFT	0
-#define RIGHT	1
-#define BOTTOMC	2
-#define BOTTOML 3
-#define BOTTOMR 4
-#define TOPC	5
-#define TOPL	6
-#define TOPR	7
-
-static int offsets[][2] =
+static void DrawTile(int x, int y, float color[3])
 {
-	{ -4,  0 },
-	{  4,  0 },
-	{  0, -4 },
-	{ -4, -4 },
-	{  4, -4 },
-	{  0,  4 },
-	{ -4,  4 },
-	{  4,  4 }
-};
+	const float size = TILE_SIZE;
 
-// type flags
-#define	SOLID	(1 << 0)
-#define WATER	(1 << 1)
-#define LADDER  (1 << 2)
-#define FIELD   (1 << 3)
-
-#if 0
-static const char map[] = 
-"################" \
-"#wwwwwwwwwwwwww#" \
-"#wwwwwwwwwwwwww#" \
-"###########..###" \
-"#.............f#" \
-"#.1....11.....f#" \
-"#....111......f#" \
-"#.............f#" \
-"#.....111#####f#" \
-"#......l......f#" \
-"#......l......f#" \
-"#......l......f#" \
-"#######l##....f#" \
-"#......l......f#" \
-"#......l......f#" \
-"################";
-#endif
-
-static const char map[] = 
-"################" \
-"#wwwwwwwwwwwwww#" \
-"#wwwwwwwwwwwwww#" \
-"###########..###" \
-"#.............f#" \
-"#.1....11#####f#" \
-"#....111######f#" \
-"#.....11######f#" \
-"#.....111#####f#" \
-"#......l......f#" \
-"#......l......f#" \
-"#......l......f#" \
-"#######l##....f#" \
-"#......l......f#" \
-"#......l......f#" \
-"################";
-
-// measured in tiles
-static char Map_Tile(float x, float y)
-{
-	int xx = x / 16;
-	int yy = y / 16;
+	glColor3fv(color);
 
-	int addr = yy * 16 + xx;
-	return map[addr];
+	x *= size;
+	y *= size;
+
+	glBegin(GL_TRIANGLE_STRIP);
+	glVertex2f(x + 0.0f, y + 0.0f);
+	glVertex2f(x + size, y + 0.0f);
+	glVertex2f(x + 0.0f, y + size);
+	glVertex2f(x + size, y + size);
+	glEnd();
 }
 
 
 
-static int Map_TileType(float x, float y)
-{
-	char tile = Map_Tile(x, y);
-	int type = 0;
-
-	if (tile == 'w')
-		type |= WATER;
-	if (tile == '#')
-		type |= SOLID;
-	if (tile == 'l')
-		type |= LADDER;
-	if (tile == 'f')
-		type |= FIELD;
-
-	return type;
-}
+//
+// The view is 256x256 units and follows the player across larger maps
+//
 
+#define VIEW_SIZE	256
 
+static float vieworigin[2];
 
-bool Map_Solid(float x, float y)
+static float ViewOrigin(float pos, int maptiles)
 {
-	char tile = Map_Tile(x, y);
-	if (tile == '#')
-		return true;
-
-	// jump through collisions
-	if (tile == '1')
-	{
-		// True if and only if the current position and the next position
-		// of the object are intersecting the tile boundary and the intersection
-		// slop line
-		const float slop = 1.0f / 16.0f;
-		float line1 = ((floor((nexty - 4.0f) / 16.0f) + 1) * 16.0f);
-		float line2 = ((floor((nexty - 4.0f) / 16.0f) + 1) * 16.0f) - slop;
-		float u = (objy  - 4.0f);
-		float v = (nexty - 4.0f);
-
-		return (u >= v) && (u >= line2) && (v <= line1); 
-	}
+	float mapsize = maptiles * TILE_SIZE;
+	if (mapsize <= VIEW_SIZE)
+		return 0.0f;
 
-	// jump through collisions
-	if (tile == 'l')
-	{
-		// True if and only if the current position and the next position
-		// of the object are intersecting the tile boundary and the intersection
-		// slop line
-		const float slop = 1.0f / 16.0f;
-		float line1 = ((floor((nextx - 4.0f) / 16.0f) + 1) * 16.0f);
-		float line2 = ((floor((nextx - 4.0f) / 16.0f) + 1) * 16.0f) - slop;
-		float u = (objx  - 4.0f);
-		float v = (nextx - 4.0f);
-
-		return (u >= v) && (u >= line2) && (v <= line1); 
-	}
+	float origin = pos - VIEW_SIZE / 2;
+	if (origin < 0.0f)
+		origin = 0.0f;
+	if (origin > mapsize - VIEW_SIZE)
+		origin = mapsize - VIEW_SIZE;
 
-	return false;
+	return origin;
 }
 
 
 
-static bool Map_OnContents(int type)
+static void SetView(float x, float y)
 {
-	bool tl = (Map_TileType(nextx - 4, nexty + 4) & type) != 0;
-	bool tr = (Map_TileType(nextx + 4, nexty + 4) & type) != 0;
-	bool bl = (Map_TileType(nextx - 4, nexty - 4) & type) != 0;
-	bool br = (Map_TileType(nextx + 4, nexty - 4) & type) != 0;
-	
-	return tl || tr || bl || br;
-}
+	vieworigin[0] = ViewOrigin(x, Map_Width());
+	vieworigin[1] = ViewOrigin(y, Map_Height());
 
-// oversample on the bottom to allow to get above the last ladder tile
-// fixme: need to stop at the top
-static bool Map_OnLadder()
-{
-	return Map_OnContents(LADDER);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(vieworigin[0], vieworigin[0] + VIEW_SIZE, vieworigin[1], vieworigin[1] + VIEW_SIZE, -1, 1);
 }
 
-static bool Map_OnWater()
-{
-	return Map_OnContents(WATER);
-}
 
-//
-// Player
-//
 
-static void Player()
+// the range of tiles on one axis overlapping the view, clipped to the map
+static void ViewTiles(int axis, int maptiles, int &first, int &last)
 {
-	float newvelx = 0.0f;
-	float newvely = 0.0f;
-	int groundtype = Map_TileType(objx, objy - 4);
+	first = (int)(vieworigin[axis] / TILE_SIZE);
+	last = (int)((vieworigin[axis] + VIEW_SIZE - 1) / TILE_SIZE);
+	if (last >= maptiles)
+		last = maptiles - 1;
+}
 
-	// runnning logic
-	if (onground)
-	{
-		// apply ground friction
-		if (!movex)
-		{
-			velx *= 0.7f;
-			if (fabs(velx) < 0.1f)
-				velx = 0.0f;
-		}
 
-		float runvel = 0.25f * movex;
-		if (buttonz)
-			runvel *= 2;
 
-		// apply input move
-		newvelx += runvel;
-	}
-
-	// air control
-	if (!onground)
-	{
-		newvelx += 0.1f * movex;
-	}
+static void DrawTiles_Immediate()
+{
+	int x0, x1, y0, y1;
+	ViewTiles(0, Map_Width(), x0, x1);
+	ViewTiles(1, Map_Height(), y0, y1);
 
-	// swimming
-	if (groundtype & WATER)
+	for (int y = y0; y <= y1; y++)
 	{
-		if (buttonx && simframe > lastjump + 5)
+		for (int x = x0; x <= x1; x++)
 		{
-			newvely += 5.0f;
-			lastjump = simframe;
-			printf("swim\n");
-		}
-	}
+			float *c = LookupColor(x * 16, y * 16);
 
-	// jump logic
-	{
-		if ((onground || ladderstate) && buttonx && simframe > lastjump + 10)
-		{
-			newvely += 5.0f;
-			lastjump = simframe;
-			ladderstate = false;
-			//printf("jump\n");
+			DrawTile(x, y, c);
 		}
-
-		// allow larger jumps
-		if ((simframe < lastjump + 10) && buttonx && vely > 0.0f)
-			newvely += 1.0f;
 	}
-
-	// ladder logic
-	{
-		// walk on and walk off ladder
-		if (Map_OnLadder())
-		{
-			if (!ladderstate && (movey > 0.0f))
-			{
-				ladderstate = true;
-				velx = vely = 0.0f;
-			}
-
-			// check for walk off ladder
-			if (ladderstate && onground && (movey <= 0.0f))
-				ladderstate = false;
-		}
-
-		// check for move off ladder
-		if (ladderstate && !Map_OnLadder())
-			ladderstate = false;
-
-		// detach from ladder
-		if (ladderstate && (movey < 0.0f) && buttonx)
-			ladderstate = false;
-
-		// ladder movement
-		if (ladderstate)
-		{
-			velx = vely = 0;
-
-			if (movex > 0)
-				velx = 1.0f;
-			else if (movex < 0)
-				velx = -1.0f;
-
-			if (movey > 0)
-				vely = 1.0f;
-			else if (movey < 0)
-				vely = -1.0f;
-		}
-	}
-
-	velx += newvelx;
-	vely += newvely;
 }
 
-
 //
-// Physics / Movement code
+// The tile layer is static, so the tiles in a region around the view are
+// built once into a vertex buffer of coloured triangles, drawn with one call
+// when the view spans whole rows and one multi draw of the visible part of
+// each row otherwise. The region is rebuilt when the
+// view leaves it or the map revision changes, so only tiles near the player
+// are ever read, which keeps -chunks streaming. -immediate draws tile by tile
+// for comparison.
 //
 
-static bool Move_OnGround()
+struct tilevertex_t
 {
-	//bool tl = Map_Solid(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]);
-	//bool tr = Map_Solid(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]);
-	bool bl = Map_Solid(nextx + offsets[BOTTOML][0], nexty - 4.0f);
-	bool br = Map_Solid(nextx + offsets[BOTTOMR][0], nexty - 4.0f);
+	float	x, y;
+	float	color[3];
+};
 
-	int code = (br << 3) | (bl << 2);// | (tr << 1) | (tl << 0);
-	//printf("code=%i\n", code);
+#define TILE_VERTEXES	6
+#define TILE_REGION		64		// tiles a side, at least twice the view
 
-	if (code == 0x4)
-	{
-		static const float slop = 1.0f / 16.0f;
+static bool immediate;
+static bool soft;
+static softframe_t softframe;
+static GLuint tilebuffer;
+static unsigned int tilebufferrevision;
+static int tileregion[4];		// first x, first y, width, height in tiles
+static tilevertex_t tilevertexes[TILE_REGION * TILE_REGION * TILE_VERTEXES];
 
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x - slop;
-
-		//printf("dx=%f, dy=%f\n", dx, dy);
+// the start of a region around first to last, clipped to the map
+static int TileRegionStart(int first, int last, int maptiles)
+{
+	int start = first - (TILE_REGION - (last - first + 1)) / 2;
+	if (start > maptiles - TILE_REGION)
+		start = maptiles - TILE_REGION;
+	if (start < 0)
+		start = 0;
 
-		return (dy < dx);
-	}
-	else if (code == 0x8)
-	{
-		static const float slop = 1.0f / 16.0f;
+	return start;
+}
 
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f) - slop;
-		//printf("dx=%f, dy=%f\n", dx, dy);
 
-		return (dy < dx);
-	}
-	else
-	{
-		return (code == 0xc) || (code == 0xd) || (code == 0xe);
-	}
-}
 
-#if 0
-static bool PointTrace(float ox, float oy)
+static void BuildTileBuffer(int x0, int x1, int y0, int y1)
 {
-	char tile = Map_Tile(nextx + ox, nexty + oy);
+	static const int corners[TILE_VERTEXES][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
 
-	if (tile == '#')
-		return true;
+	int rx = TileRegionStart(x0, x1, Map_Width());
+	int ry = TileRegionStart(y0, y1, Map_Height());
+	int rw = Map_Width() - rx < TILE_REGION ? Map_Width() - rx : TILE_REGION;
+	int rh = Map_Height() - ry < TILE_REGION ? Map_Height() - ry : TILE_REGION;
 
-	// jump through collisions
-	if (tile == '1')
+	tilevertex_t *v = tilevertexes;
+	for (int y = ry; y < ry + rh; y++)
 	{
-		// True if and only if the current position and the next position
-		// of the object are intersecting the tile boundary and the intersection
-		// slop line
-		const float slop = 1.0f / 16.0f;
-		float line1 = ((floor((nexty + oy) / 16.0f) + 1) * 16.0f);
-		float line2 = ((floor((nexty + oy) / 16.0f) + 1) * 16.0f) - slop;
-		float u = (objy  - oy);
-		float v = (nexty - oy);
-
-		return (oy < 0.0f) && (u >= v) && (u >= line2) && (v <= line1); 
+		for (int x = rx; x < rx + rw; x++)
+		{
+			float *c = LookupColor(x * 16, y * 16);
+
+			for (int j = 0; j < TILE_VERTEXES; j++, v++)
+			{
+				v->x = (x + corners[j][0]) * TILE_SIZE;
+				v->y = (y + corners[j][1]) * TILE_SIZE;
+				v->color[0] = c[0];
+				v->color[1] = c[1];
+				v->color[2] = c[2];
+			}
+		}
 	}
 
-	return false;
-}
-#endif
+	if (!tilebuffer)
+		glGenBuffers(1, &tilebuffer);
 
-static int Move_ClipCode(char tile)
-{
-	bool tl = Map_Solid(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]);
-	bool tr = Map_Solid(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]);
-	bool bl = Map_Solid(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]);
-	bool br = Map_Solid(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]);
+	glBindBuffer(GL_ARRAY_BUFFER, tilebuffer);
+	glBufferData(GL_ARRAY_BUFFER, (v - tilevertexes) * sizeof(tilevertex_t), tilevertexes, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	tl &= (Map_Tile(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]) == tile);
-	tr &= (Map_Tile(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]) == tile);
-	bl &= (Map_Tile(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]) == tile);
-	br &= (Map_Tile(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]) == tile);
+	tileregion[0] = rx;
+	tileregion[1] = ry;
+	tileregion[2] = rw;
+	tileregion[3] = rh;
+	tilebufferrevision = Map_Revision();
+}
 
-	int code = (br << 3) | (bl << 2) | (tr << 1) | (tl << 0);
 
-	return code;
-}
 
-// the concept here is to resolve the penetration by moving along the smallest axis
-// based upon the classification of the intersection
-static void Move_Clip_Solid()
+static void DrawTiles()
 {
-	// 16 subpixel intersection slop
-	//static const float slop = 1.0f / 64.0f;
-	static const float slop = 1.0f / 16.0f;
-
-	//bool tl = Map_Solid(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]);
-	//bool tr = Map_Solid(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]);
-	//bool bl = Map_Solid(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]);
-	//bool br = Map_Solid(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]);
-
-	//tl &= Map_Tile(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]) == '#';
-	//tr &= Map_Tile(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]) == '#';
-	//bl &= Map_Tile(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]) == '#';
-	//br &= Map_Tile(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]) == '#';
-
-	//int code = (br << 3) | (bl << 2) | (tr << 1) | (tl << 0);
-	int code = Move_ClipCode('#');
-	//printf("\rcode %i  (%i %i %i %i) " , code, tl, tr, bl, br);
-	//printf("code %i\n" , code);
-	//fflush(stdout);
-
-	if (code == 0x5)
-	{
-		// left	
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x - slop;
-		nextx += dx;
-		velx = 0;
-	}
-	else if (code == 0xa)
+	if (immediate)
 	{
-		// right
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f) - slop;
-		nextx -= dx;
-		velx = 0;
-	}
-	else if (code == 0x3)
-	{
-		// top
-		float y = nexty + 4.0;
-		float dy = y - (floor(y / 16.0f) * 16.0f) - slop;
-		nexty -= dy;
-		vely = 0;
-	}
-	else if (code == 0xc)
-	{
-		// bottom
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		nexty += dy;
-		vely = 0;
+		DrawTiles_Immediate();
+		return;
 	}
-	else if (code == 0x4)
-	{
-		// convex bottom left
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x - slop;
 
-		if (dx < dy)
-		{
-			// push out on x axis (left)
-			nextx += dx;
-			if (velx < 0.0f)
-				velx = 0;
-		}
-		else
-		{
-			// push out on y axis
-			nexty += dy;;
-			if (vely < 0.0f)
-				vely = 0;
-		}
-	}
-	else if (code == 0x8)
+	int x0, x1, y0, y1;
+	ViewTiles(0, Map_Width(), x0, x1);
+	ViewTiles(1, Map_Height(), y0, y1);
+
+	if (!tilebuffer || tilebufferrevision != Map_Revision() ||
+		x0 < tileregion[0] || x1 >= tileregion[0] + tileregion[2] ||
+		y0 < tileregion[1] || y1 >= tileregion[1] + tileregion[3])
+		BuildTileBuffer(x0, x1, y0, y1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, tilebuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(tilevertex_t), (void*)offsetof(tilevertex_t, x));
+	glColorPointer(3, GL_FLOAT, sizeof(tilevertex_t), (void*)offsetof(tilevertex_t, color));
+
+	// the region is row major, so whole rows are one range and the columns in
+	// view are one range per row otherwise
+	int columns = x1 - x0 + 1;
+	int first = ((y0 - tileregion[1]) * tileregion[2] + x0 - tileregion[0]) * TILE_VERTEXES;
+	if (x0 == tileregion[0] && columns == tileregion[2])
 	{
-		// convex bottom right
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f) - slop;
-
-		if (dx < dy)
-		{
-			nextx -= dx;
-			if (velx > 0.0f)
-				velx = 0;
-		}
-		else
-		{
-			nexty += dy;
-			if (vely < 0.0f)
-				vely = 0;
-		}
+		glDrawArrays(GL_TRIANGLES, first, (y1 - y0 + 1) * columns * TILE_VERTEXES);
 	}
-	else if (code == 0x1)
+	else
 	{
-		// convex top left	
-		float y = nexty + 4.0;
-		float dy = y - (floor(y / 16.0f) * 16.0f) - slop;
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x - slop;
+		GLint firsts[TILE_REGION];
+		GLsizei counts[TILE_REGION];
 
-		if (dx < dy)
-		{
-			nextx += dx;
-			if (velx < 0.0f)
-				velx = 0;
-		}
-		else
+		for (int y = y0; y <= y1; y++)
 		{
-			nexty -= dy;
-			if (vely > 0.0f)
-				vely = 0;
+			firsts[y - y0] = first + (y - y0) * tileregion[2] * TILE_VERTEXES;
+			counts[y - y0] = columns * TILE_VERTEXES;
 		}
-	}
-	else if (code == 0x2)
-	{
-		// convex top right
-		float y = nexty + 4.0;
-		float dy = y - (floor(y / 16.0f) * 16.0f) + slop;
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f) + slop;
-		
-		if (dx < dy)
-		{
-			nextx -= dx;
-			if (velx > 0.0f)
-				velx = 0;
-		}
-		else
-		{
-			nexty -= dy;
-			if (vely > 0.0f)
-				vely = 0;
-		}
-	}
-	else if (code == 0x7)
-	{
-		// concave top left
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x;
-		nextx += dx;
-		velx = 0;
-
-		float y = nexty + 4.0;
-		float dy = y - (floor(y / 16.0f) * 16.0f);
-		nexty -= dy;
-		vely = 0;
-	}
-	else if (code == 0xb)
-	{
-		// concave top right
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f);
-		nextx -= dx;
-		velx = 0;
-
-		float y = nexty + 4.0;
-		float dy = y - (floor(y / 16.0f) * 16.0f);
-		nexty -= dy;
-		vely = 0;
-	}
-	else if (code == 0xd)
-	{
-		// concave bottom left
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x;
-		nextx += dx;
-		velx = 0;
-
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		nexty += dy;
-		vely = 0;
-	}
-	else if (code == 0xe)
-	{
-		// concave bottom right
-		float x = nextx + 4.0;
-		float dx = x - (floor(x / 16.0f) * 16.0f);
-		nextx -= dx;
-		velx = 0;
-
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		nexty += dy;
-		vely = 0;
-	}
-	else if (code == 0xf)
-	{
-		nextx += 1;
-		velx = 0;
-		vely = 0;
-	}
-}
-
-// This is the Move_Clip for a one-way tile
-static void Move_Clip_OneWay()
-{
-	// 16 subpixel intersection slop
-	//static const float slop = 1.0f / 64.0f;
-	static const float slop = 1.0f / 16.0f;
-	//static const float slop = 0.0f;
-
-	//bool tl = Map_Solid(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]);
-	//bool tr = Map_Solid(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]);
-	//bool bl = Map_Solid(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]);
-	//bool br = Map_Solid(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]);
-
-	//tl &= Map_Tile(nextx + offsets[TOPL][0], nexty + offsets[TOPL][1]) == '1';
-	//tr &= Map_Tile(nextx + offsets[TOPR][0], nexty + offsets[TOPR][1]) == '1';
-	//bl &= Map_Tile(nextx + offsets[BOTTOML][0], nexty + offsets[BOTTOML][1]) == '1';
-	//br &= Map_Tile(nextx + offsets[BOTTOMR][0], nexty + offsets[BOTTOMR][1]) == '1';
-
-	//int code = (br << 3) | (bl << 2) | (tr << 1) | (tl << 0);
-	int code = Move_ClipCode('1');
 
-	if (code == 0x7 || code == 0xb || code == 0xc || code == 0x8 || code == 0x4 || code == 0xd || code == 0xe || code == 0xf)
-	{
-		//printf("collide %i\n", code);
-		float y = nexty - 4.0;
-		float dy = ((floor(y / 16.0f) + 1) * 16.0f) - y - slop;
-		nexty += dy;
-		vely = 0;
+		glMultiDrawArrays(GL_TRIANGLES, firsts, counts, y1 - y0 + 1);
 	}
-}
 
-static void Move_Clip_OneX()
-{
-	static const float slop = 1.0f / 16.0f;
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	int code = Move_ClipCode('l');
 
-	if (code == 0x5 || code == 0x1 || code == 0x4)
-	{
-		// left	
-		float x = nextx - 4.0;
-		float dx = ((floor(x / 16.0f) + 1) * 16.0f) - x - slop;
-		nextx += dx;
-		velx = 0;
-	}
-}
 
-static void Move_Clip()
+static void DrawObject(float x, float y)
 {
-	Move_Clip_OneWay();
+	float xx = x - 4.0f;
+	float yy = y - 4.0f;
 
-	Move_Clip_OneX();
+	glColor3f(1, 0, 1);
 
-	// solid must be resolved last
-	Move_Clip_Solid();
+	glBegin(GL_TRIANGLE_STRIP);
+	glVertex2f(xx + 0.0f, yy + 0.0f);
+	glVertex2f(xx + 8.0f, yy + 0.0f);
+	glVertex2f(xx + 0.0f, yy + 8.0f);
+	glVertex2f(xx + 8.0f, yy + 8.0f);
+	glEnd();
 }
 
 
 
-static void Move_Air()
+static void ReshapeFunc(int w, int h)
 {
-	// apply gravity
-	vely -= 1;
-
-	if (vely <= -5)
-		vely = -5;
+	glViewport(0, 0, w, h);
 
-	// clamp the velocities
-	if (velx >= 5)
-		velx = 5;
-	if (velx <= -5)
-		velx = -5;
+	// stretch the software frame over the window
+	if (soft)
+		glPixelZoom((float)w / softframe.width, (float)h / softframe.height);
 }
 
 
 
-static void Move_Water()
+static void DisplayFunc()
 {
-	// apply sinking
-	vely -= 1.0f;
-
-	float maxy = 2.0f;
-	if (vely <= -maxy)
-		vely = -maxy;
-
-	float maxx = 2.0f;
-	if (velx >= maxx)
-		velx = maxx;
-	if (velx <= -maxx)
-		velx = -maxx;
-}
+	uint64_t t = Prof_Begin();
 
+	// the body is drawn between its last two sim positions. objx is the
+	// position at simtime, which is at most one step ahead of realtime
+	float x, y, px, py;
+	unsigned int simtime, now;
 
+	if (threaded)
+	{
+		// the latest published frame, against the current clock
+		const renderstate_t &state = RenderBuffer_Latest(renderbuffer);
+		x = state.objx;
+		y = state.objy;
+		px = state.prevx;
+		py = state.prevy;
+		simtime = state.simtime;
+		now = Sys_Milliseconds() - state.droppedtime;
+	}
+	else
+	{
+		const body_t &player = world.player;
+		x = (float)player.objx;
+		y = (float)player.objy;
+		px = (float)player.prevx;
+		py = (float)player.prevy;
+		simtime = world.simtime;
+		now = realtime;
+	}
 
-static void Movement()
-{
-	int type = Map_TileType(objx, objy);
+	if (!nolerp)
+	{
+		float alpha = 1.0f - (float)(int)(simtime - now) / SIM_TIMESTEP;
+		if (alpha < 0.0f)
+			alpha = 0.0f;
+		if (alpha > 1.0f)
+			alpha = 1.0f;
+
+		x = px + (x - px) * alpha;
+		y = py + (y - py) * alpha;
+	}
 
-	// figure out which physics to apply
-	// fixme: add explicit ladder physics
-	if (!ladderstate)
+	if (soft)
 	{
-		if (type & WATER)
-			Move_Water();
-		else
-			Move_Air();
+		// rasterise on the cpu and just blit the result
+		R_SoftDrawFrame(softframe, x, y);
 
-		// field
-		if (Map_OnContents(FIELD) && (vely < 10.0f))
-			vely += 1.0f;
+		glWindowPos2i(0, 0);
+		glDrawPixels(softframe.width, softframe.height, GL_RGBA, GL_UNSIGNED_BYTE, softframe.pixels);
 	}
+	else
+	{
+		glClearColor(0.3, 0.3, 0.3, 0.0);
+		glClear(GL_COLOR_BUFFER_BIT);
 
-	// try the move
-	nextx = objx + velx;
-	nexty = objy + vely;
-
-	// clip the move
-	Move_Clip();
+		SetView(x, y);
+		DrawTiles();
 
-	prevx = objx;
-	prevy = objy;
-	objx = nextx;
-	objy = nexty;
+		DrawObject(x, y);
+	}
+	t = Prof_End(PHASE_DISPLAY, t);
 
-	//printf("obj %f, %f\n", objx, objy);
-	// evaluate the 'ground state'
-	onground = Move_OnGround();
-	//printf("onground %s\n", (onground ? "yes" : "no"));
+	glutSwapBuffers();
+	Prof_End(PHASE_SWAP, t);
 }
 
 // --------------------------------------------------------------------------------
-// Rendering
+// Main
 
-static float *LookupColor(int x, int y)
+// sleeps until the next sim frame or, when renders share the thread, the next
+// render is due. returns false when spinning and no time has passed
+static bool Loop_Wait(unsigned int &newtime, bool renders)
 {
-	static float colors[6][3] = 
+	newtime = Sys_Milliseconds();
+
+	if (spin)
 	{
-		{ 1, 0, 0 },
-		{ 0, 0, 1 },
-		{ 1, 1, 1 },
-		{ 1, 1, 0 },
-		{ 0, 1, 1 },
-		{ 0.5, 0, 0 },
-	};
+		// yield the thread if no time has advanced
+		if (newtime == lasttime)
+		{
+			Sys_Sleep(0);
+			return false;
+		}
 
-	char tile = Map_Tile(x, y);
-	if (tile == '#')
-		return colors[0];
-	else if (tile == 'w')
-		return colors[1];
-	else if (tile == 'l')
-		return colors[3];
-	else if (tile == 'f')
-		return colors[4];
-	else if (tile == '1')
-		return colors[5];
-	else
-		return colors[2];
+		return true;
+	}
+
+	unsigned int deadline = world.simtime + 1 + droppedtime;
+	if (renders && renderinterval && lastrender + renderinterval < deadline)
+		deadline = lastrender + renderinterval;
+
+	if ((int)(deadline - newtime) > 0)
+	{
+		Sys_Sleep(deadline - newtime);
+		newtime = Sys_Milliseconds();
+	}
+
+	return true;
 }
 
 
 
-static void DrawTile(int x, int y, float color[3])
+// runs the sim frames due by newtime, returns how many
+static unsigned int Loop_RunFrames(unsigned int newtime)
 {
-	const float size = TILE_SIZE;
+	lasttime = newtime;
+	realtime = newtime - droppedtime;
+	loopstats.wakeups++;
 
-	glColor3fv(color);
+	// run the simulation code until it has caught up
+	unsigned int steps = 0;
+	while (world.simtime < realtime)
+	{
+		if (steps == maxsteps)
+		{
+			unsigned int behind = (realtime - world.simtime + SIM_TIMESTEP - 1) / SIM_TIMESTEP;
+			droppedtime += behind * SIM_TIMESTEP;
+			realtime -= behind * SIM_TIMESTEP;
+			loopstats.dropped += behind;
+			break;
+		}
 
-	x *= size;
-	y *= size;
+		uint64_t t = Prof_Begin();
+		usercmd_t cmd;
+		if (threaded)
+			DrainKeys();
+		BuildMoveCommand(cmd, keyactions);
+		Prof_End(PHASE_BUILDCMD, t);
+		if (demo.fp)
+			Demo_WriteCommand(demo, cmd);
+		SimRunFrame(world, cmd);
+		steps++;
+	}
 
-	glBegin(GL_TRIANGLE_STRIP);
-	glVertex2f(x + 0.0f, y + 0.0f);
-	glVertex2f(x + size, y + 0.0f);
-	glVertex2f(x + 0.0f, y + size);
-	glVertex2f(x + size, y + size);
-	glEnd();
+	loopstats.frames += steps;
+	if (steps > 1)
+		loopstats.caughtup += steps - 1;
+
+	return steps;
 }
 
 
 
-static void DrawTiles()
+static void Loop_Publish()
 {
-	for (int i = 0; i < 256; i++)
-	{
-		int y = i / 16;
-		int x = i % 16;
-		
-		float *c = LookupColor(x * 16, y * 16);
+	renderstate_t &state = RenderBuffer_Back(renderbuffer);
 
-		DrawTile(x, y, c);
-	}
+	state.prevx = (float)world.player.prevx;
+	state.prevy = (float)world.player.prevy;
+	state.objx = (float)world.player.objx;
+	state.objy = (float)world.player.objy;
+	state.simtime = world.simtime;
+	state.droppedtime = droppedtime;
+	state.simframe = world.simframe;
+
+	RenderBuffer_Publish(renderbuffer);
 }
 
 
 
-static void DrawObject(float x, float y)
+static void MainLoopFunc()
 {
-	float xx = x - 4.0f;
-	float yy = y - 4.0f;
+	unsigned int newtime;
+	if (!Loop_Wait(newtime, true))
+		return;
 
-	glColor3f(1, 0, 1);
+	unsigned int steps = Loop_RunFrames(newtime);
 
-	glBegin(GL_TRIANGLE_STRIP);
-	glVertex2f(xx + 0.0f, yy + 0.0f);
-	glVertex2f(xx + 8.0f, yy + 0.0f);
-	glVertex2f(xx + 0.0f, yy + 8.0f);
-	glVertex2f(xx + 8.0f, yy + 8.0f);
-	glEnd();
+	// signal a rendering update
+	if (spin || steps || (renderinterval && newtime - lastrender >= renderinterval))
+	{
+		lastrender = newtime;
+		glutPostRedisplay();
+	}
 }
 
 
 
-static void ReshapeFunc(int w, int h)
+static void *SimThreadFunc(void *arg)
 {
-	glMatrixMode(GL_PROJECTION);
-	glOrtho(0, 256, 0, 256, -1, 1);
+	while (!__atomic_load_n(&simquit, __ATOMIC_ACQUIRE))
+	{
+		unsigned int newtime;
+		if (!Loop_Wait(newtime, false))
+			continue;
 
-	glViewport(0, 0, w, h);
+		if (Loop_RunFrames(newtime))
+			Loop_Publish();
+	}
+
+	return NULL;
 }
 
 
 
-static void DisplayFunc()
+// the idle func when threaded, only schedules renders
+static void WindowLoopFunc()
 {
-	glClearColor(0.3, 0.3, 0.3, 0.0);
-	glClear(GL_COLOR_BUFFER_BIT);
+	unsigned int newtime = Sys_Milliseconds();
 
-	DrawTiles();
+	if (__atomic_load_n(&profready, __ATOMIC_ACQUIRE))
+	{
+		Prof_Snapshot(profsnapshot, PHASE_DISPLAY, PHASE_SWAP);
+		Prof_DumpSnapshot(stdout, profsnapshot);
+		__atomic_store_n(&profready, false, __ATOMIC_RELEASE);
+	}
 
-	DrawObject(objx, objy);
+	if (renderinterval)
+	{
+		// sleep until the next render is due
+		if ((int)(lastrender + renderinterval - newtime) > 0)
+		{
+			Sys_Sleep(lastrender + renderinterval - newtime);
+			newtime = Sys_Milliseconds();
+		}
+	}
+	else if (!RenderBuffer_Fresh(renderbuffer))
+	{
+		// render each new sim frame
+		Sys_Sleep(1);
+		return;
+	}
 
-	glutSwapBuffers();
+	lastrender = newtime;
+	glutPostRedisplay();
 }
-// --------------------------------------------------------------------------------
-// Main
 
-unsigned int Sys_Milliseconds (void)
-{
-	struct timeval	tp;
-	static int		secbase;
-	static int		curtime;
 
-	gettimeofday(&tp, NULL);
 
-	if (!secbase)
+static void Shutdown()
+{
+	if (threaded)
 	{
-		secbase = tp.tv_sec;
+		__atomic_store_n(&simquit, true, __ATOMIC_RELEASE);
+		pthread_join(simthread, NULL);
 	}
 
-	curtime = (tp.tv_sec - secbase) * 1000 + tp.tv_usec / 1000;
+	Demo_Close(demo);
 
-	return curtime;
+	unsigned int msecs = Sys_Milliseconds() - starttime;
+	if (!msecs)
+		msecs = 1;
+
+	printf("%u frames in %u wakeups, %u caught up, %u dropped\n",
+		loopstats.frames, loopstats.wakeups, loopstats.caughtup, loopstats.dropped);
+	printf("%s%s loop, %.1f%% cpu over %u msecs\n", threaded ? "threaded " : "", spin ? "spinning" : "sleeping",
+		(Sys_CpuMilliseconds() - startcpu) * 100.0 / msecs, msecs);
+	Prof_Dump(stdout);
 }
 
 
 
-void Sys_Sleep(unsigned int msecs)
+int main(int argc, char *argv[])
 {
-	usleep(msecs * 1000);
-}
+	const char *recordname = NULL;
+	const char *mapname = NULL;
+	int chunkpool = 0;
 
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-record") && i + 1 < argc)
+			recordname = argv[++i];
+		else if (!strcmp(argv[i], "-maxsteps") && i + 1 < argc)
+			maxsteps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-maxfps") && i + 1 < argc)
+		{
+			int fps = atoi(argv[++i]);
+			renderinterval = fps > 0 ? 1000 / fps : 0;
+		}
+		else if (!strcmp(argv[i], "-spin"))
+			spin = true;
+		else if (!strcmp(argv[i], "-threaded"))
+			threaded = true;
+		else if (!strcmp(argv[i], "-nolerp"))
+			nolerp = true;
+		else if (!strcmp(argv[i], "-immediate"))
+			immediate = true;
+		else if (!strcmp(argv[i], "-soft"))
+			soft = true;
+		else if (!strcmp(argv[i], "-map") && i + 1 < argc)
+			mapname = argv[++i];
+		else if (!strcmp(argv[i], "-chunks") && i + 1 < argc)
+			chunkpool = atoi(argv[++i]);
+	}
 
-static void SimRunFrame()
-{
-	//printf("===== simrunframe =====\n");
-	simframe++;
-	simtime = simframe * SIM_TIMESTEP;
+	if (maxsteps < 1)
+		maxsteps = 1;
 
-	BuildMoveCommand();
+	// the display reads the map too, and the chunk hash belongs to one thread
+	if (threaded && chunkpool)
+	{
+		fprintf(stderr, "-threaded can't be used with -chunks\n");
+		return 1;
+	}
 
-	Player();
+	Map_Init();
+	// -chunks streams the map through a pool of resident chunks
+	if (mapname && !(chunkpool ? Map_LoadChunked(mapname, chunkpool) : Map_Load(mapname)))
+		return 1;
 
-	Movement();
-}
+	World_Init(world);
 
+	// the 512x512 window is twice the 256 unit view
+	if (soft && !R_SoftInit(softframe, 2))
+		return 1;
 
+	// record the commands from the first frame so the log replays from World_Init
+	if (recordname && !Demo_OpenWrite(demo, recordname, world.simframe + 1))
+		return 1;
 
-static void MainLoopFunc()
-{
-	unsigned int newtime = Sys_Milliseconds();
+	Prof_Enable(true);
+	starttime = Sys_Milliseconds();
+	startcpu = Sys_CpuMilliseconds();
 
-	// yield the thread if no time has advanced
-	if (newtime == realtime)
+	if (threaded)
 	{
-		Sys_Sleep(0);
-		return;
-	}
-
-	realtime = newtime;
+		KeyQueue_Init(keyqueue);
 
-	// run the simulation code
-	if (simtime < realtime)
-		SimRunFrame();
-
-	// signal a rendering update
-	glutPostRedisplay();
-}
+		renderstate_t state;
+		memset(&state, 0, sizeof(state));
+		RenderBuffer_Init(renderbuffer, state);
+		Loop_Publish();
 
+		if (pthread_create(&simthread, NULL, SimThreadFunc, NULL))
+		{
+			fprintf(stderr, "couldn't start the sim thread\n");
+			return 1;
+		}
+	}
 
+	atexit(Shutdown);
 
-int main(int argc, char *argv[])
-{
 	// glutmain
 	glutInit(&argc, argv);
 	glutInitWindowSize(512, 512);
 	glutCreateWindow("test window");
 	glutDisplayFunc(DisplayFunc);
 	glutReshapeFunc(ReshapeFunc);
-	glutIdleFunc(MainLoopFunc);
+	glutIdleFunc(threaded ? WindowLoopFunc : MainLoopFunc);
 	glutKeyboardFunc(KeyDownFunc);
 	glutKeyboardUpFunc(KeyUpFunc);
 	glutSpecialFunc(SpecialDownFunc);
@@ -1014,4 +810,3 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
-
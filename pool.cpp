@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "sys.h"
+#include "pool.h"
+
+// --------------------------------------------------------------------------------
+// Workers
+//
+// A shard is a range of task indexes packed in one word, so the owner taking
+// from the front and thieves taking from the back agree through a single
+// compare and swap. Each tick the calling thread fills the shards, bumps the
+// generation to wake the other workers and works shard 0 itself.
+
+struct alignas(64) poolshard_t
+{
+	uint64_t		range;			// next task in the low half, end in the high half
+};
+
+struct alignas(64) poolslot_t
+{
+	poolworker_t	stats;
+};
+
+static int numworkers;
+static pthread_t threads[POOL_MAX_WORKERS];
+static poolshard_t shards[POOL_MAX_WORKERS];
+static poolslot_t slots[POOL_MAX_WORKERS];
+static histogram_t tickhist;
+static bool stealing = true;
+
+// the current tick, written before the workers are woken
+static pooltask_t job;
+static void *jobdata;
+
+static pthread_mutex_t poollock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t poolwake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pooldone = PTHREAD_COND_INITIALIZER;
+static unsigned int generation;
+static int pending;					// woken workers still running the tick
+static bool poolquit;
+
+static inline uint64_t Pool_Range(uint32_t next, uint32_t end)
+{
+	return ((uint64_t)end << 32) | next;
+}
+
+
+
+static int Pool_TakeFront(poolshard_t &shard)
+{
+	uint64_t range = __atomic_load_n(&shard.range, __ATOMIC_ACQUIRE);
+
+	for (;;)
+	{
+		uint32_t next = (uint32_t)range;
+		uint32_t end = (uint32_t)(range >> 32);
+		if (next >= end)
+			return -1;
+
+		if (__atomic_compare_exchange_n(&shard.range, &range, Pool_Range(next + 1, end), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return next;
+	}
+}
+
+
+
+static int Pool_TakeBack(poolshard_t &shard)
+{
+	uint64_t range = __atomic_load_n(&shard.range, __ATOMIC_ACQUIRE);
+
+	for (;;)
+	{
+		uint32_t next = (uint32_t)range;
+		uint32_t end = (uint32_t)(range >> 32);
+		if (next >= end)
+			return -1;
+
+		if (__atomic_compare_exchange_n(&shard.range, &range, Pool_Range(next, end - 1), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return end - 1;
+	}
+}
+
+
+
+// runs tasks until every shard is empty, the time from start to running dry
+// is the worker's busy time for the tick
+static void Pool_Work(int worker)
+{
+	poolworker_t &stats = slots[worker].stats;
+	uint64_t start = Sys_Nanoseconds();
+
+	for (;;)
+	{
+		int task = Pool_TakeFront(shards[worker]);
+		bool stolen = false;
+
+		// steal from the other shards in turn, starting after our own
+		if (task < 0 && stealing)
+		{
+			for (int i = 1; i < numworkers && task < 0; i++)
+				task = Pool_TakeBack(shards[(worker + i) % numworkers]);
+			stolen = task >= 0;
+		}
+
+		if (task < 0)
+			break;
+
+		job(task, jobdata);
+
+		stats.sessions++;
+		if (stolen)
+			stats.steals++;
+	}
+
+	stats.busy += Sys_Nanoseconds() - start;
+}
+
+
+
+static void *Pool_Thread(void *arg)
+{
+	int worker = (int)(intptr_t)arg;
+	unsigned int seen = 0;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&poollock);
+		while (generation == seen && !poolquit)
+			pthread_cond_wait(&poolwake, &poollock);
+
+		if (poolquit)
+		{
+			pthread_mutex_unlock(&poollock);
+			return NULL;
+		}
+
+		seen = generation;
+		pthread_mutex_unlock(&poollock);
+
+		Pool_Work(worker);
+
+		pthread_mutex_lock(&poollock);
+		if (--pending == 0)
+			pthread_cond_signal(&pooldone);
+		pthread_mutex_unlock(&poollock);
+	}
+}
+
+// --------------------------------------------------------------------------------
+// Pool
+
+bool Pool_Init(int count)
+{
+	if (count < 1 || count > POOL_MAX_WORKERS)
+	{
+		fprintf(stderr, "pool: %i workers, must be 1 to %i\n", count, POOL_MAX_WORKERS);
+		return false;
+	}
+
+	memset(slots, 0, sizeof(slots));
+	memset(&tickhist, 0, sizeof(tickhist));
+	poolquit = false;
+	numworkers = 1;
+
+	for (int i = 1; i < count; i++)
+	{
+		if (pthread_create(&threads[i], NULL, Pool_Thread, (void*)(intptr_t)i))
+		{
+			fprintf(stderr, "pool: couldn't start worker %i\n", i);
+			Pool_Shutdown();
+			return false;
+		}
+
+		numworkers++;
+	}
+
+	return true;
+}
+
+
+
+void Pool_Shutdown()
+{
+	pthread_mutex_lock(&poollock);
+	poolquit = true;
+	pthread_cond_broadcast(&poolwake);
+	pthread_mutex_unlock(&poollock);
+
+	for (int i = 1; i < numworkers; i++)
+		pthread_join(threads[i], NULL);
+
+	numworkers = 0;
+}
+
+
+
+void Pool_SetStealing(bool enable)
+{
+	stealing = enable;
+}
+
+
+
+void Pool_Run(int numtasks, pooltask_t task, void *data)
+{
+	uint64_t start = Sys_Nanoseconds();
+
+	job = task;
+	jobdata = data;
+
+	for (int i = 0; i < numworkers; i++)
+	{
+		uint32_t begin = (uint32_t)((int64_t)numtasks * i / numworkers);
+		uint32_t end = (uint32_t)((int64_t)numtasks * (i + 1) / numworkers);
+		__atomic_store_n(&shards[i].range, Pool_Range(begin, end), __ATOMIC_RELAXED);
+	}
+
+	// the lock publishes the job and the shards to the woken workers
+	pthread_mutex_lock(&poollock);
+	generation++;
+	pending = numworkers - 1;
+	pthread_cond_broadcast(&poolwake);
+	pthread_mutex_unlock(&poollock);
+
+	Pool_Work(0);
+
+	pthread_mutex_lock(&poollock);
+	while (pending)
+		pthread_cond_wait(&pooldone, &poollock);
+	pthread_mutex_unlock(&poollock);
+
+	Hist_Add(tickhist, Sys_Nanoseconds() - start);
+}
+
+
+
+void Pool_Stats(poolstats_t &stats)
+{
+	memset(&stats, 0, sizeof(stats));
+
+	stats.numworkers = numworkers;
+	stats.ticks = tickhist;
+	for (int i = 0; i < numworkers; i++)
+		stats.workers[i] = slots[i].stats;
+}
+
+
+
+void Pool_Dump(FILE *fp)
+{
+	if (!tickhist.count)
+		return;
+
+	fprintf(fp, "%-10s %10s %10s %10s %10s %10s  (usecs)\n", "tick", "count", "mean", "p50", "p99", "max");
+	fprintf(fp, "%-10s %10llu %10.3f %10.3f %10.3f %10.3f\n", "wall",
+		(unsigned long long)tickhist.count,
+		tickhist.total / 1000.0 / tickhist.count,
+		Hist_Percentile(tickhist, 0.5) / 1000.0,
+		Hist_Percentile(tickhist, 0.99) / 1000.0,
+		tickhist.max / 1000.0);
+
+	// utilisation is the share of the ticks' wall time a worker had work
+	fprintf(fp, "%-10s %10s %10s %10s\n", "worker", "busy", "sessions", "steals");
+	for (int i = 0; i < numworkers; i++)
+	{
+		const poolworker_t &stats = slots[i].stats;
+		fprintf(fp, "%-10i %9.1f%% %10u %10u\n", i,
+			100.0 * stats.busy / tickhist.total, stats.sessions, stats.steals);
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sim.h"
+#include "prof.h"
+
+// --------------------------------------------------------------------------------
+// Session pool
+//
+// Steps many independent sessions in parallel on a fixed set of workers, the
+// calling thread being worker 0. Every tick the sessions are split into one
+// contiguous shard per worker. A worker takes sessions from the front of its
+// shard and when it runs dry steals from the back of the others, so a session
+// with a slow frame doesn't hold up the rest of its shard.
+//
+// Sessions only share the map, which must not be chunked: the chunk hash
+// belongs to a single sim thread. Profiling must be off for the same reason.
+
+#define POOL_MAX_WORKERS	64
+
+struct poolworker_t
+{
+	uint64_t		busy;			// nsecs spent stepping sessions
+	unsigned int	sessions;		// sessions stepped
+	unsigned int	steals;			// of those, taken from other shards
+};
+
+struct poolstats_t
+{
+	int				numworkers;
+	histogram_t		ticks;			// wall time of each Pool_Run
+	poolworker_t	workers[POOL_MAX_WORKERS];
+};
+
+bool Pool_Init(int numworkers);
+void Pool_Shutdown();
+
+// turns stealing off, so each worker only steps its own shard
+void Pool_SetStealing(bool enable);
+
+typedef void (*pooltask_t)(int task, void *data);
+
+// runs task 0 to numtasks - 1 across the workers as one tick and returns
+// when all of them are done
+void Pool_Run(int numtasks, pooltask_t task, void *data);
+
+void Pool_Stats(poolstats_t &stats);
+// per tick wall time and per worker utilisation and steals
+void Pool_Dump(FILE *fp);
+
+#endif
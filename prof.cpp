@@ -0,0 +1,132 @@
+#include <string.h>
+#include "prof.h"
+
+bool prof_enabled;
+
+static histogram_t histograms[NUM_PHASES];
+
+static const char *phasenames[NUM_PHASES] =
+{
+	"buildcmd",
+	"player",
+	"movement",
+	"display",
+	"swap",
+};
+
+// --------------------------------------------------------------------------------
+// Histograms
+
+static int Hist_Bucket(uint64_t ns)
+{
+	if (ns < HIST_SUB)
+		return (int)ns;
+
+	int e = 63 - __builtin_clzll(ns);
+	int sub = (ns >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1);
+	int bucket = (e - HIST_SUB_BITS + 1) * HIST_SUB + sub;
+
+	return bucket < HIST_BUCKETS ? bucket : HIST_BUCKETS - 1;
+}
+
+
+
+// smallest value that lands in the bucket
+static uint64_t Hist_BucketValue(int bucket)
+{
+	if (bucket < HIST_SUB)
+		return bucket;
+
+	int e = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+	int sub = bucket % HIST_SUB;
+
+	return (uint64_t)(HIST_SUB + sub) << (e - HIST_SUB_BITS);
+}
+
+
+
+uint64_t Hist_Percentile(const histogram_t &hist, double p)
+{
+	uint64_t target = (uint64_t)(hist.count * p);
+	if (target >= hist.count)
+		target = hist.count - 1;
+
+	uint64_t seen = 0;
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += hist.counts[i];
+		if (seen > target)
+			return Hist_BucketValue(i);
+	}
+
+	return hist.max;
+}
+
+
+
+void Hist_Add(histogram_t &hist, uint64_t ns)
+{
+	hist.counts[Hist_Bucket(ns)]++;
+	hist.count++;
+	hist.total += ns;
+	if (ns > hist.max)
+		hist.max = ns;
+}
+
+// --------------------------------------------------------------------------------
+// Phases
+
+void Prof_Enable(bool enable)
+{
+	prof_enabled = enable;
+}
+
+
+
+void Prof_Record(profphase_t phase, uint64_t ns)
+{
+	Hist_Add(histograms[phase], ns);
+}
+
+
+
+static void Prof_Print(FILE *fp, const histogram_t *hists)
+{
+	fprintf(fp, "%-10s %10s %10s %10s %10s %10s  (usecs)\n", "phase", "count", "mean", "p50", "p99", "max");
+
+	for (int i = 0; i < NUM_PHASES; i++)
+	{
+		const histogram_t &hist = hists[i];
+		if (!hist.count)
+			continue;
+
+		fprintf(fp, "%-10s %10llu %10.3f %10.3f %10.3f %10.3f\n", phasenames[i],
+			(unsigned long long)hist.count,
+			hist.total / 1000.0 / hist.count,
+			Hist_Percentile(hist, 0.5) / 1000.0,
+			Hist_Percentile(hist, 0.99) / 1000.0,
+			hist.max / 1000.0);
+	}
+}
+
+
+
+void Prof_Dump(FILE *fp)
+{
+	Prof_Print(fp, histograms);
+}
+
+
+
+void Prof_Snapshot(profsnapshot_t &snap, profphase_t first, profphase_t last)
+{
+	for (int i = first; i <= last; i++)
+		snap.histograms[i] = histograms[i];
+}
+
+
+
+void Prof_DumpSnapshot(FILE *fp, const profsnapshot_t &snap)
+{
+	Prof_Print(fp, snap.histograms);
+}
@@ -0,0 +1,75 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sys.h"
+
+// --------------------------------------------------------------------------------
+// Frame phase timing
+//
+// Each phase records its duration into a fixed size log-linear histogram,
+// 16 buckets per power of two nanoseconds, so percentiles are within about
+// 6% without storing samples. Timing is off unless Prof_Enable is called and
+// costs a predictable branch per phase when off.
+
+enum profphase_t
+{
+	PHASE_BUILDCMD,
+	PHASE_PLAYER,
+	PHASE_MOVEMENT,
+	PHASE_DISPLAY,
+	PHASE_SWAP,
+	NUM_PHASES
+};
+
+#define HIST_SUB_BITS	4
+#define HIST_SUB		(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	1024
+
+struct histogram_t
+{
+	unsigned int	counts[HIST_BUCKETS];
+	uint64_t		count;
+	uint64_t		total;
+	uint64_t		max;
+};
+
+void Hist_Add(histogram_t &hist, uint64_t ns);
+uint64_t Hist_Percentile(const histogram_t &hist, double p);
+
+extern bool prof_enabled;
+
+void Prof_Enable(bool enable);
+void Prof_Record(profphase_t phase, uint64_t ns);
+void Prof_Dump(FILE *fp);
+
+// the phases are recorded on different threads when the sim is threaded, each
+// thread copies the phases it records so the dump never reads a histogram
+// while it's written
+struct profsnapshot_t
+{
+	histogram_t		histograms[NUM_PHASES];
+};
+
+// copies the phases first through last
+void Prof_Snapshot(profsnapshot_t &snap, profphase_t first, profphase_t last);
+void Prof_DumpSnapshot(FILE *fp, const profsnapshot_t &snap);
+
+inline uint64_t Prof_Begin()
+{
+	return prof_enabled ? Sys_Nanoseconds() : 0;
+}
+
+// records the phase started at begin, returns the end time so phases can chain
+inline uint64_t Prof_End(profphase_t phase, uint64_t begin)
+{
+	if (!prof_enabled)
+		return 0;
+
+	uint64_t now = Sys_Nanoseconds();
+	Prof_Record(phase, now - begin);
+	return now;
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "sim.h"
+#include "r_soft.h"
+
+#define SOFT_ALIGN		16
+
+#define RGBA(r, g, b)	((uint32_t)(r) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | 0xff000000u)
+
+// same colours as the gl frontend
+static const uint32_t tilecolors[] =
+{
+	RGBA(255, 0, 0),
+	RGBA(0, 0, 255),
+	RGBA(255, 255, 255),
+	RGBA(255, 255, 0),
+	RGBA(0, 255, 255),
+	RGBA(128, 0, 0),
+};
+
+static const uint32_t playercolor = RGBA(255, 0, 255);
+
+// --------------------------------------------------------------------------------
+// Setup
+
+bool R_SoftInit(softframe_t &frame, int scale)
+{
+	memset(&frame, 0, sizeof(frame));
+
+	if (scale < 1)
+		return false;
+
+	frame.scale = scale;
+	frame.width = SOFT_VIEW_SIZE * scale;
+	frame.height = SOFT_VIEW_SIZE * scale;
+
+	size_t size = (size_t)frame.width * frame.height * sizeof(uint32_t);
+	if (posix_memalign((void**)&frame.pixels, SOFT_ALIGN, size) ||
+		posix_memalign((void**)&frame.background, SOFT_ALIGN, size))
+	{
+		R_SoftShutdown(frame);
+		return false;
+	}
+
+	frame.rowbuffer = (unsigned char*)malloc(frame.width * 3);
+
+	return frame.rowbuffer != NULL;
+}
+
+
+
+void R_SoftShutdown(softframe_t &frame)
+{
+	free(frame.pixels);
+	free(frame.background);
+	free(frame.rowbuffer);
+	memset(&frame, 0, sizeof(frame));
+}
+
+// --------------------------------------------------------------------------------
+// Rasterisation
+
+static void R_SoftFillRow(uint32_t *row, int count, uint32_t color)
+{
+#ifdef __SSE2__
+	// align to the vector width, then fill four pixels per store
+	while (count && ((uintptr_t)row & (SOFT_ALIGN - 1)))
+	{
+		*row++ = color;
+		count--;
+	}
+
+	__m128i c = _mm_set1_epi32(color);
+	for (; count >= 8; count -= 8, row += 8)
+	{
+		_mm_store_si128((__m128i*)row, c);
+		_mm_store_si128((__m128i*)(row + 4), c);
+	}
+	for (; count >= 4; count -= 4, row += 4)
+		_mm_store_si128((__m128i*)row, c);
+#endif
+
+	while (count--)
+		*row++ = color;
+}
+
+
+
+// fills [x0, x1) x [y0, y1) in pixels, clipped to the frame
+void R_SoftFillRect(softframe_t &frame, uint32_t *pixels, int x0, int y0, int x1, int y1, uint32_t color)
+{
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 > frame.width)
+		x1 = frame.width;
+	if (y1 > frame.height)
+		y1 = frame.height;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	for (int y = y0; y < y1; y++)
+		R_SoftFillRow(pixels + y * frame.width + x0, x1 - x0, color);
+}
+
+
+
+static void R_SoftBuildBackground(softframe_t &frame, int originx, int originy)
+{
+	int size = TILE_SIZE * frame.scale;
+
+	// the tiles overlapping the view, the ones off the map draw as outside
+	int x0 = originx / size;
+	int y0 = originy / size;
+	int x1 = (originx + frame.width - 1) / size;
+	int y1 = (originy + frame.height - 1) / size;
+
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			uint32_t color = tilecolors[TILE_COLOR(Map_Tile(x * TILE_SIZE, y * TILE_SIZE))];
+
+			int px = x * size - originx;
+			int py = y * size - originy;
+			R_SoftFillRect(frame, frame.background, px, py, px + size, py + size, color);
+		}
+	}
+
+	frame.revision = Map_Revision();
+	frame.originx = originx;
+	frame.originy = originy;
+	frame.backgroundvalid = true;
+}
+
+
+
+// centres the view on the player, kept inside the map when it's larger than
+// the view
+static int R_SoftViewOrigin(const softframe_t &frame, float pos, int maptiles)
+{
+	float mapsize = maptiles * TILE_SIZE;
+	if (mapsize <= SOFT_VIEW_SIZE)
+		return 0;
+
+	float origin = pos - SOFT_VIEW_SIZE / 2;
+	if (origin < 0.0f)
+		origin = 0.0f;
+	if (origin > mapsize - SOFT_VIEW_SIZE)
+		origin = mapsize - SOFT_VIEW_SIZE;
+
+	return (int)floorf(origin * frame.scale);
+}
+
+
+
+void R_SoftDrawFrame(softframe_t &frame, float playerx, float playery)
+{
+	int originx = R_SoftViewOrigin(frame, playerx, Map_Width());
+	int originy = R_SoftViewOrigin(frame, playery, Map_Height());
+
+	if (!frame.backgroundvalid || frame.revision != Map_Revision() || frame.originx != originx || frame.originy != originy)
+		R_SoftBuildBackground(frame, originx, originy);
+
+	memcpy(frame.pixels, frame.background, (size_t)frame.width * frame.height * sizeof(uint32_t));
+
+	// the player is an 8x8 box centred on its position
+	int x0 = (int)floorf((playerx - 4.0f) * frame.scale + 0.5f) - originx;
+	int y0 = (int)floorf((playery - 4.0f) * frame.scale + 0.5f) - originy;
+	int size = 8 * frame.scale;
+
+	R_SoftFillRect(frame, frame.pixels, x0, y0, x0 + size, y0 + size, playercolor);
+}
+
+// --------------------------------------------------------------------------------
+// Output
+
+// appends a binary ppm, concatenated frames make a stream ffmpeg can read
+bool R_SoftWritePPM(const softframe_t &frame, FILE *fp)
+{
+	fprintf(fp, "P6\n%i %i\n255\n", frame.width, frame.height);
+
+	for (int y = frame.height - 1; y >= 0; y--)
+	{
+		const uint32_t *src = frame.pixels + y * frame.width;
+		unsigned char *dst = frame.rowbuffer;
+
+		for (int x = 0; x < frame.width; x++, dst += 3)
+		{
+			dst[0] = src[x];
+			dst[1] = src[x] >> 8;
+			dst[2] = src[x] >> 16;
+		}
+
+		if (fwrite(frame.rowbuffer, 3, frame.width, fp) != (size_t)frame.width)
+			return false;
+	}
+
+	return true;
+}
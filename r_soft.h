@@ -0,0 +1,41 @@
+#ifndef R_SOFT_H
+#define R_SOFT_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// --------------------------------------------------------------------------------
+// Software renderer
+//
+// Rasterises the tile map and the player into a 32 bit RGBA buffer without
+// GL, for producing frames on machines with no GPU. The frame shows a
+// 256x256 unit view that follows the player across larger maps, drawn at an
+// integer scale. Rows are stored bottom up like glDrawPixels expects,
+// R_SoftWritePPM flips them.
+
+#define SOFT_VIEW_SIZE	256
+
+struct softframe_t
+{
+	int				width, height;
+	int				scale;
+	uint32_t		*pixels;
+
+	// the tile layer, rebuilt when the map revision or the view changes
+	uint32_t		*background;
+	unsigned int	revision;
+	int				originx, originy;	// view origin in pixels
+	bool			backgroundvalid;
+
+	unsigned char	*rowbuffer;		// one row of rgb for the ppm writer
+};
+
+bool R_SoftInit(softframe_t &frame, int scale);
+void R_SoftShutdown(softframe_t &frame);
+
+void R_SoftFillRect(softframe_t &frame, uint32_t *pixels, int x0, int y0, int x1, int y1, uint32_t color);
+void R_SoftDrawFrame(softframe_t &frame, float playerx, float playery);
+
+bool R_SoftWritePPM(const softframe_t &frame, FILE *fp);
+
+#endif
@@ -0,0 +1,69 @@
+#include <string.h>
+#include "rollback.h"
+
+// --------------------------------------------------------------------------------
+// Snapshots
+
+void Snapshot_Save(snapshot_t &snapshot, const world_t &world)
+{
+	memcpy(&snapshot.world, &world, sizeof(world));
+}
+
+
+
+void Snapshot_Restore(world_t &world, const snapshot_t &snapshot)
+{
+	memcpy(&world, &snapshot.world, sizeof(world));
+}
+
+// --------------------------------------------------------------------------------
+// Rollback
+
+void Rollback_Init(rollback_t &rollback, const world_t &world)
+{
+	memset(&rollback, 0, sizeof(rollback));
+	rollback.firstframe = world.simframe + 1;
+}
+
+
+
+// saves the state and the command, then runs the frame
+void Rollback_RunFrame(rollback_t &rollback, world_t &world, const usercmd_t &cmd)
+{
+	int slot = ROLLBACK_SLOT(world.simframe + 1);
+
+	Snapshot_Save(rollback.snapshots[slot], world);
+	rollback.cmds[slot] = cmd;
+
+	SimRunFrame(world, cmd);
+}
+
+
+
+bool Rollback_CanCorrect(const rollback_t &rollback, const world_t &world, unsigned int simframe)
+{
+	if (simframe < rollback.firstframe || simframe > world.simframe)
+		return false;
+
+	return world.simframe - simframe < ROLLBACK_FRAMES;
+}
+
+
+
+// replaces the command of a frame that has already run and simulates
+// forward again to the current frame
+bool Rollback_Correct(rollback_t &rollback, world_t &world, unsigned int simframe, const usercmd_t &cmd)
+{
+	if (!Rollback_CanCorrect(rollback, world, simframe))
+		return false;
+
+	unsigned int lastframe = world.simframe;
+
+	Snapshot_Restore(world, rollback.snapshots[ROLLBACK_SLOT(simframe)]);
+	rollback.cmds[ROLLBACK_SLOT(simframe)] = cmd;
+
+	while (world.simframe < lastframe)
+		Rollback_RunFrame(rollback, world, rollback.cmds[ROLLBACK_SLOT(world.simframe + 1)]);
+
+	return true;
+}
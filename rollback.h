@@ -0,0 +1,40 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <type_traits>
+#include "sim.h"
+
+// --------------------------------------------------------------------------------
+// Snapshots and rollback
+//
+// The whole simulation state lives in world_t, so a snapshot is a plain copy
+// of it. The rollback ring keeps the state before each of the last
+// ROLLBACK_FRAMES frames along with the frame's command, so a late command
+// can replace a predicted one and the frames since are simulated again.
+
+#define ROLLBACK_FRAMES		16		// must be a power of two
+#define ROLLBACK_SLOT(f)	((f) & (ROLLBACK_FRAMES - 1))
+
+struct snapshot_t
+{
+	world_t		world;
+};
+
+static_assert(std::is_trivially_copyable<snapshot_t>::value, "snapshots are saved with memcpy");
+
+struct rollback_t
+{
+	snapshot_t		snapshots[ROLLBACK_FRAMES];	// state before the frame ran
+	usercmd_t		cmds[ROLLBACK_FRAMES];
+	unsigned int	firstframe;					// oldest frame ever held
+};
+
+void Snapshot_Save(snapshot_t &snapshot, const world_t &world);
+void Snapshot_Restore(world_t &world, const snapshot_t &snapshot);
+
+void Rollback_Init(rollback_t &rollback, const world_t &world);
+void Rollback_RunFrame(rollback_t &rollback, world_t &world, const usercmd_t &cmd);
+bool Rollback_CanCorrect(const rollback_t &rollback, const world_t &world, unsigned int simframe);
+bool Rollback_Correct(rollback_t &rollback, world_t &world, unsigned int simframe, const usercmd_t &cmd);
+
+#endif
@@ -0,0 +1,1698 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sim.h"
+#include "sim_local.h"
+#include "prof.h"
+
+// the collision policy of SimRunFrame and Body_Step
+#ifndef SIM_COLLIDE
+#define SIM_COLLIDE	collide_full_t
+#endif
+
+typedef SIM_COLLIDE sim_collide_t;
+
+// the collision policy of the other entry points in sim_local.h, which the
+// batched paths use. the vector kernels in sim_simd.cpp only classify for
+// this one, so it doesn't follow SIM_COLLIDE
+typedef collide_full_t batch_collide_t;
+
+// --------------------------------------------------------------------------------
+// Move commands
+
+void BuildMoveCommand(usercmd_t &cmd, const bool keys[NUM_KEY_ACTIONS])
+{
+	cmd.movex = 0;
+	if (keys[ka_left])
+		cmd.movex -= 1;
+	if (keys[ka_right])
+		cmd.movex += 1;
+
+	cmd.movey = 0;
+	if (keys[ka_down])
+		cmd.movey -= 1;
+	if (keys[ka_up])
+		cmd.movey += 1;
+
+	cmd.buttonx = keys[ka_x];
+	cmd.buttonz = keys[ka_y];
+}
+
+
+
+// --------------------------------------------------------------------------------
+// Game logic
+
+//
+// Map
+// 
+
+#define LEFT	0
+#define RIGHT	1
+#define BOTTOMC	2
+#define BOTTOML 3
+#define BOTTOMR 4
+#define TOPC	5
+#define TOPL	6
+#define TOPR	7
+
+static int offsets[][2] =
+{
+	{ -4,  0 },
+	{  4,  0 },
+	{  0, -4 },
+	{ -4, -4 },
+	{  4, -4 },
+	{  0,  4 },
+	{ -4,  4 },
+	{  4,  4 }
+};
+
+#if 0
+static const char map[] = 
+"################" \
+"#wwwwwwwwwwwwww#" \
+"#wwwwwwwwwwwwww#" \
+"###########..###" \
+"#.............f#" \
+"#.1....11.....f#" \
+"#....111......f#" \
+"#.............f#" \
+"#.....111#####f#" \
+"#......l......f#" \
+"#......l......f#" \
+"#......l......f#" \
+"#######l##....f#" \
+"#......l......f#" \
+"#......l......f#" \
+"################";
+#endif
+
+static const char map[] = 
+"################" \
+"#wwwwwwwwwwwwww#" \
+"#wwwwwwwwwwwwww#" \
+"###########..###" \
+"#.............f#" \
+"#.1....11#####f#" \
+"#....111######f#" \
+"#.....11######f#" \
+"#.....111#####f#" \
+"#......l......f#" \
+"#......l......f#" \
+"#......l......f#" \
+"#######l##....f#" \
+"#......l......f#" \
+"#......l......f#" \
+"################";
+
+// tile flags for every map character, the colour index is the one used by
+// the renderer
+static constexpr tile_t Map_CharFlags(int c)
+{
+	return
+		(c == '#') ? SOLID | (0 << TILE_COLOR_SHIFT) :
+		(c == 'w') ? WATER | (1 << TILE_COLOR_SHIFT) :
+		(c == 'l') ? LADDER | ONEWAYX | (3 << TILE_COLOR_SHIFT) :
+		(c == 'f') ? FIELD | (4 << TILE_COLOR_SHIFT) :
+		(c == '1') ? ONEWAY | (5 << TILE_COLOR_SHIFT) :
+		(2 << TILE_COLOR_SHIFT);
+}
+
+struct chartable_t
+{
+	tile_t	flags[256];
+};
+
+static constexpr chartable_t Map_BuildCharTable()
+{
+	chartable_t table = {};
+	for (int i = 0; i < 256; i++)
+		table.flags[i] = Map_CharFlags(i);
+	return table;
+}
+
+static constexpr chartable_t charflags = Map_BuildCharTable();
+
+// the current map, row major from the bottom left. The tile array is
+// followed by one padding tile so 32 bit gathers of the last tile stay
+// inside it
+const tile_t *mapflags;
+int mapwidth;
+int mapheight;
+
+static int mapspawn[2];
+static unsigned int maprevision;
+
+// the built in map, or the mapped file
+static tile_t builtinflags[BUILTIN_MAP_SIZE * BUILTIN_MAP_SIZE + 1];
+static void *mapmapping;
+static size_t mapmappingsize;
+
+// one bitset per tile flag, rows of maplayerwords 64 bit words. Each layer
+// is followed by a padding word so unaligned 16 bit reads of the last tiles
+// stay inside it. NULL for chunked maps
+static uint64_t *maplayers;
+static int maplayerwords;
+static size_t maplayersize;		// words per layer, including the padding
+
+static void Map_BuildLayers()
+{
+	free(maplayers);
+
+	maplayerwords = (mapwidth + 63) >> 6;
+	maplayersize = (size_t)maplayerwords * mapheight + 1;
+	maplayers = (uint64_t*)calloc(NUM_LAYERS * maplayersize, sizeof(uint64_t));
+
+	for (int y = 0; y < mapheight; y++)
+	{
+		const tile_t *row = mapflags + (size_t)y * mapwidth;
+
+		for (int x = 0; x < mapwidth; x++)
+		{
+			for (int bits = row[x] & LAYER_FLAGS; bits; bits &= bits - 1)
+			{
+				int layer = __builtin_ctz(bits);
+				maplayers[layer * maplayersize + (size_t)y * maplayerwords + (x >> 6)] |= (uint64_t)1 << (x & 63);
+			}
+		}
+	}
+}
+
+
+
+static void Map_FreeLayers()
+{
+	free(maplayers);
+	maplayers = NULL;
+}
+
+
+
+static void Map_Unmap()
+{
+	if (mapmapping)
+		munmap(mapmapping, mapmappingsize);
+
+	mapmapping = NULL;
+	mapmappingsize = 0;
+}
+
+
+
+void Map_Init()
+{
+	Map_Unmap();
+	Chunk_Shutdown();
+
+	for (int i = 0; i < BUILTIN_MAP_SIZE * BUILTIN_MAP_SIZE; i++)
+		builtinflags[i] = charflags.flags[(unsigned char)map[i]];
+
+	mapflags = builtinflags;
+	mapwidth = BUILTIN_MAP_SIZE;
+	mapheight = BUILTIN_MAP_SIZE;
+	mapspawn[0] = 32;
+	mapspawn[1] = 128;
+
+	Map_BuildLayers();
+	maprevision++;
+}
+
+
+
+// maps the file read only and shared, so loading is constant time and
+// processes on the same level share the pages
+bool Map_Load(const char *filename)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "map: couldn't open %s\n", filename);
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(mapheader_t))
+	{
+		fprintf(stderr, "map: %s is too small\n", filename);
+		close(fd);
+		return false;
+	}
+
+	size_t size = st.st_size;
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		fprintf(stderr, "map: couldn't map %s\n", filename);
+		return false;
+	}
+
+	const mapheader_t *header = (const mapheader_t*)mapping;
+	const char *error = NULL;
+
+	if (memcmp(header->magic, MAP_MAGIC, sizeof(header->magic)))
+		error = "not a map";
+	else if (header->width <= 0 || header->height <= 0 || header->width > MAP_MAX_SIZE || header->height > MAP_MAX_SIZE)
+		error = "bad size";
+	else if (size < sizeof(mapheader_t) + ((size_t)header->width * header->height + 1) * sizeof(tile_t))
+		error = "truncated";
+
+	if (error)
+	{
+		fprintf(stderr, "map: %s: %s\n", filename, error);
+		munmap(mapping, size);
+		return false;
+	}
+
+	Map_Unmap();
+	Chunk_Shutdown();
+	mapmapping = mapping;
+	mapmappingsize = size;
+
+	mapflags = (const tile_t*)(header + 1);
+	mapwidth = header->width;
+	mapheight = header->height;
+	mapspawn[0] = header->spawnx;
+	mapspawn[1] = header->spawny;
+
+	Map_BuildLayers();
+	maprevision++;
+
+	return true;
+}
+
+
+
+bool Map_LoadChunked(const char *filename, int poolsize)
+{
+	mapheader_t header;
+	FILE *fp = fopen(filename, "rb");
+	if (!fp)
+	{
+		fprintf(stderr, "map: couldn't open %s\n", filename);
+		return false;
+	}
+
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1;
+	fclose(fp);
+	if (!ok)
+	{
+		fprintf(stderr, "map: %s is too small\n", filename);
+		return false;
+	}
+
+	// Chunk_Init leaves the current map alone if it fails
+	if (!Chunk_Init(filename, poolsize))
+		return false;
+
+	Map_Unmap();
+	Map_FreeLayers();
+
+	mapspawn[0] = header.spawnx;
+	mapspawn[1] = header.spawny;
+
+	maprevision++;
+
+	return true;
+}
+
+
+
+bool Map_Write(const char *filename)
+{
+	if (mapchunked)
+	{
+		fprintf(stderr, "map: can't write a chunked map\n");
+		return false;
+	}
+
+	FILE *fp = fopen(filename, "wb");
+	if (!fp)
+	{
+		fprintf(stderr, "map: couldn't open %s\n", filename);
+		return false;
+	}
+
+	mapheader_t header;
+	memcpy(header.magic, MAP_MAGIC, sizeof(header.magic));
+	header.width = mapwidth;
+	header.height = mapheight;
+	header.spawnx = mapspawn[0];
+	header.spawny = mapspawn[1];
+
+	tile_t pad = 0;
+	size_t numtiles = (size_t)mapwidth * mapheight;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(mapflags, sizeof(tile_t), numtiles, fp) == numtiles &&
+		fwrite(&pad, sizeof(pad), 1, fp) == 1;
+
+	if (fclose(fp) || !ok)
+	{
+		fprintf(stderr, "map: couldn't write %s\n", filename);
+		return false;
+	}
+
+	return true;
+}
+
+
+
+// changes whenever the tiles do, so renderers know to rebuild
+unsigned int Map_Revision()
+{
+	return maprevision;
+}
+
+
+
+int Map_Width()
+{
+	return mapwidth;
+}
+
+
+
+int Map_Height()
+{
+	return mapheight;
+}
+
+
+
+// measured in tiles, everything outside the map is solid
+tile_t Map_Tile(vec_t x, vec_t y)
+{
+	int xx = Tile_Index(x);
+	int yy = Tile_Index(y);
+
+	if ((unsigned)xx >= (unsigned)mapwidth || (unsigned)yy >= (unsigned)mapheight)
+		return MAP_OUTSIDE;
+
+	if (mapchunked)
+		return Chunk_Tile(xx, yy);
+
+	return mapflags[yy * mapwidth + xx];
+}
+
+
+
+int Map_TileType(vec_t x, vec_t y)
+{
+	return Map_Tile(x, y) & TILE_CONTENTS;
+}
+
+
+
+// True if and only if the current position and the next position of the
+// object are intersecting the tile boundary and the intersection slop line.
+// Takes the box centre on the axis of the one way tile.
+bool Map_OneWayCrossed(vec_t cur, vec_t next)
+{
+	const vec_t slop = 1.0f / 16.0f;
+	vec_t line1 = Tile_Next(next - 4.0f);
+	vec_t line2 = Tile_Next(next - 4.0f) - slop;
+	vec_t u = (cur  - 4.0f);
+	vec_t v = (next - 4.0f);
+
+	return (u >= v) && (u >= line2) && (v <= line1); 
+}
+
+
+
+// solidity of an already sampled tile for the body's move
+template <class collide>
+static bool Map_SolidTile(const body_t &body, tile_t tile)
+{
+	tile &= collide::tiles;
+
+	if (tile & SOLID)
+		return true;
+
+	// jump through collisions
+	if (tile & ONEWAY)
+		return Map_OneWayCrossed(body.objy, body.nexty);
+
+	// jump through collisions
+	if (tile & ONEWAYX)
+		return Map_OneWayCrossed(body.objx, body.nextx);
+
+	return false;
+}
+
+
+
+bool Map_SolidTile(const body_t &body, tile_t tile)
+{
+	return Map_SolidTile<batch_collide_t>(body, tile);
+}
+
+
+
+template <class collide>
+static bool Map_Solid(const body_t &body, vec_t x, vec_t y)
+{
+	return Map_SolidTile<collide>(body, Map_Tile(x, y));
+}
+
+
+
+bool Map_Solid(const body_t &body, vec_t x, vec_t y)
+{
+	return Map_Solid<batch_collide_t>(body, x, y);
+}
+
+
+
+// true if any corner of the box centered at x, y touches the contents type
+bool Map_OnContents(vec_t x, vec_t y, int type)
+{
+	int xl = Tile_Index(x - 4);
+	int xr = Tile_Index(x + 4);
+	int yb = Tile_Index(y - 4);
+	int yt = Tile_Index(y + 4);
+
+	// the box spans at most two tiles a side, so each row of corners is a
+	// single 16 bit read of the layer. Boxes hanging off the map and chunked
+	// maps sample the corners
+	if (!maplayers || xl < 0 || yb < 0 || xr >= mapwidth || yt >= mapheight)
+	{
+		bool tl = (Map_TileType(x - 4, y + 4) & type) != 0;
+		bool tr = (Map_TileType(x + 4, y + 4) & type) != 0;
+		bool bl = (Map_TileType(x - 4, y - 4) & type) != 0;
+		bool br = (Map_TileType(x + 4, y - 4) & type) != 0;
+
+		return tl || tr || bl || br;
+	}
+
+	unsigned int mask = (1u | (1u << (xr - xl))) << (xl & 7);
+	size_t top = ((size_t)yt * maplayerwords << 3) + (xl >> 3);
+	size_t bottom = ((size_t)yb * maplayerwords << 3) + (xl >> 3);
+
+	for (int bits = type & LAYER_FLAGS; bits; bits &= bits - 1)
+	{
+		const unsigned char *layer = (const unsigned char*)(maplayers + __builtin_ctz(bits) * maplayersize);
+
+		uint16_t t, b;
+		memcpy(&t, layer + top, sizeof(t));
+		memcpy(&b, layer + bottom, sizeof(b));
+
+		if ((t | b) & mask)
+			return true;
+	}
+
+	return false;
+}
+
+
+
+// true if any tile in the rectangle, inclusive and measured in tiles, has
+// one of the type flags. Runs a layer word at a time
+bool Map_RegionContents(int x0, int y0, int x1, int y1, int type)
+{
+	if (x0 < 0)
+		x0 = 0;
+	if (y0 < 0)
+		y0 = 0;
+	if (x1 >= mapwidth)
+		x1 = mapwidth - 1;
+	if (y1 >= mapheight)
+		y1 = mapheight - 1;
+	if (x0 > x1 || y0 > y1)
+		return false;
+
+	if (!maplayers)
+	{
+		for (int y = y0; y <= y1; y++)
+			for (int x = x0; x <= x1; x++)
+				if (Map_TileType(x * TILE_SIZE, y * TILE_SIZE) & type)
+					return true;
+		return false;
+	}
+
+	int w0 = x0 >> 6;
+	int w1 = x1 >> 6;
+	uint64_t firstmask = ~(uint64_t)0 << (x0 & 63);
+	uint64_t lastmask = ~(uint64_t)0 >> (63 - (x1 & 63));
+
+	for (int bits = type & LAYER_FLAGS; bits; bits &= bits - 1)
+	{
+		const uint64_t *layer = maplayers + __builtin_ctz(bits) * maplayersize;
+
+		for (int y = y0; y <= y1; y++)
+		{
+			const uint64_t *row = layer + (size_t)y * maplayerwords;
+
+			for (int w = w0; w <= w1; w++)
+			{
+				uint64_t word = row[w];
+				if (w == w0)
+					word &= firstmask;
+				if (w == w1)
+					word &= lastmask;
+				if (word)
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// oversample on the bottom to allow to get above the last ladder tile
+// fixme: need to stop at the top
+static bool Map_OnLadder(const body_t &body)
+{
+	return Map_OnContents(body.nextx, body.nexty, LADDER);
+}
+
+static bool Map_OnWater(const body_t &body)
+{
+	return Map_OnContents(body.nextx, body.nexty, WATER);
+}
+
+//
+// Player
+//
+
+void Player(body_t &body, unsigned int simframe)
+{
+	vec_t newvelx = 0.0f;
+	vec_t newvely = 0.0f;
+	int groundtype = Map_TileType(body.objx, body.objy - 4);
+
+	// runnning logic
+	if (body.onground)
+	{
+		// apply ground friction
+		if (!body.cmd.movex)
+		{
+			body.velx *= 0.7f;
+			if (fabs(body.velx) < 0.1f)
+				body.velx = 0.0f;
+		}
+
+		vec_t runvel = 0.25f * body.cmd.movex;
+		if (body.cmd.buttonz)
+			runvel *= 2;
+
+		// apply input move
+		newvelx += runvel;
+	}
+
+	// air control
+	if (!body.onground)
+	{
+		newvelx += 0.1f * body.cmd.movex;
+	}
+
+	// swimming
+	if (groundtype & WATER)
+	{
+		if (body.cmd.buttonx && simframe > body.lastjump + 5)
+		{
+			newvely += 5.0f;
+			body.lastjump = simframe;
+			//printf("swim\n");
+		}
+	}
+
+	// jump logic
+	{
+		if ((body.onground || body.ladderstate) && body.cmd.buttonx && simframe > body.lastjump + 10)
+		{
+			newvely += 5.0f;
+			body.lastjump = simframe;
+			body.ladderstate = false;
+			//printf("jump\n");
+		}
+
+		// allow larger jumps
+		if ((simframe < body.lastjump + 10) && body.cmd.buttonx && body.vely > 0.0f)
+			newvely += 1.0f;
+	}
+
+	// ladder logic
+	{
+		bool onladder = Map_OnLadder(body);
+
+		// walk on and walk off ladder
+		if (onladder)
+		{
+			if (!body.ladderstate && (body.cmd.movey > 0.0f))
+			{
+				body.ladderstate = true;
+				body.velx = body.vely = 0.0f;
+			}
+
+			// check for walk off ladder
+			if (body.ladderstate && body.onground && (body.cmd.movey <= 0.0f))
+				body.ladderstate = false;
+		}
+
+		// check for move off ladder
+		if (body.ladderstate && !onladder)
+			body.ladderstate = false;
+
+		// detach from ladder
+		if (body.ladderstate && (body.cmd.movey < 0.0f) && body.cmd.buttonx)
+			body.ladderstate = false;
+
+		// ladder movement
+		if (body.ladderstate)
+		{
+			body.velx = body.vely = 0;
+
+			if (body.cmd.movex > 0)
+				body.velx = 1.0f;
+			else if (body.cmd.movex < 0)
+				body.velx = -1.0f;
+
+			if (body.cmd.movey > 0)
+				body.vely = 1.0f;
+			else if (body.cmd.movey < 0)
+				body.vely = -1.0f;
+		}
+	}
+
+	body.velx += newvelx;
+	body.vely += newvely;
+}
+
+
+//
+// Physics / Movement code
+//
+
+template <class collide>
+static bool Move_OnGround(const body_t &body)
+{
+	bool bl = Map_Solid<collide>(body, body.nextx + offsets[BOTTOML][0], body.nexty - (float)collide::probe);
+	bool br = Map_Solid<collide>(body, body.nextx + offsets[BOTTOMR][0], body.nexty - (float)collide::probe);
+
+	int code = (br << 3) | (bl << 2);
+	if (collide::groundtop)
+	{
+		bool tl = Map_Solid<collide>(body, body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]);
+		bool tr = Map_Solid<collide>(body, body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]);
+		code |= (tr << 1) | (tl << 0);
+	}
+	//printf("code=%i\n", code);
+
+	if (code == 0x4)
+	{
+		static const vec_t slop = 1.0f / 16.0f;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+
+		//printf("dx=%f, dy=%f\n", dx, dy);
+
+		return (dy < dx);
+	}
+	else if (code == 0x8)
+	{
+		static const vec_t slop = 1.0f / 16.0f;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) - slop;
+		//printf("dx=%f, dy=%f\n", dx, dy);
+
+		return (dy < dx);
+	}
+	else
+	{
+		return (code == 0xc) || (code == 0xd) || (code == 0xe);
+	}
+}
+
+
+
+bool Move_OnGround(const body_t &body)
+{
+	return Move_OnGround<batch_collide_t>(body);
+}
+
+#if 0
+static bool PointTrace(float ox, float oy)
+{
+	char tile = Map_Tile(body.nextx + ox, body.nexty + oy);
+
+	if (tile == '#')
+		return true;
+
+	// jump through collisions
+	if (tile == '1')
+	{
+		// True if and only if the current position and the next position
+		// of the object are intersecting the tile boundary and the intersection
+		// slop line
+		const float slop = 1.0f / 16.0f;
+		float line1 = ((floor((body.nexty + oy) / 16.0f) + 1) * 16.0f);
+		float line2 = ((floor((body.nexty + oy) / 16.0f) + 1) * 16.0f) - slop;
+		float u = (body.objy  - oy);
+		float v = (body.nexty - oy);
+
+		return (oy < 0.0f) && (u >= v) && (u >= line2) && (v <= line1); 
+	}
+
+	return false;
+}
+#endif
+
+// Samples the four corners of the box once and classifies them against all
+// the tile classes, see CONTACT_SOLID etc. The one way conditions only
+// depend on the body, so they're evaluated once rather than per corner.
+template <class collide>
+static int Move_ContactCodes(const body_t &body)
+{
+	tile_t tiles[4];
+	tiles[0] = Map_Tile(body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]);
+	tiles[1] = Map_Tile(body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]);
+	tiles[2] = Map_Tile(body.nextx + offsets[BOTTOML][0], body.nexty + offsets[BOTTOML][1]);
+	tiles[3] = Map_Tile(body.nextx + offsets[BOTTOMR][0], body.nexty + offsets[BOTTOMR][1]);
+
+	int contents = tiles[0] | tiles[1] | tiles[2] | tiles[3];
+	contents &= collide::tiles;
+	if (!contents)
+		return 0;
+
+	int onewaymask = 0;
+	if ((contents & ONEWAY) && Map_OneWayCrossed(body.objy, body.nexty))
+		onewaymask = ONEWAY;
+	if ((contents & ONEWAYX) && Map_OneWayCrossed(body.objx, body.nextx))
+		onewaymask |= ONEWAYX;
+
+	int codes = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (tiles[i] & SOLID)
+			codes |= CONTACT_SOLID_BIT << i;
+		if (tiles[i] & onewaymask & ONEWAY)
+			codes |= CONTACT_ONEWAY_BIT << i;
+		if (tiles[i] & onewaymask & ONEWAYX)
+			codes |= CONTACT_ONEWAYX_BIT << i;
+	}
+
+	return codes;
+}
+
+
+
+int Move_ContactCodes(const body_t &body)
+{
+	return Move_ContactCodes<batch_collide_t>(body);
+}
+
+
+
+int Move_ClipCode(const body_t &body, int type)
+{
+	int codes = Move_ContactCodes(body);
+
+	if (type == ONEWAY)
+		return CONTACT_ONEWAY(codes);
+	if (type == ONEWAYX)
+		return CONTACT_ONEWAYX(codes);
+
+	return CONTACT_SOLID(codes);
+}
+
+// the concept here is to resolve the penetration by moving along the smallest axis
+// based upon the classification of the intersection
+void Move_Clip_Solid(body_t &body, int code)
+{
+	// 16 subpixel intersection slop
+	//static const float slop = 1.0f / 64.0f;
+	static const vec_t slop = 1.0f / 16.0f;
+
+	//bool tl = Map_Solid(body, body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]);
+	//bool tr = Map_Solid(body, body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]);
+	//bool bl = Map_Solid(body, body.nextx + offsets[BOTTOML][0], body.nexty + offsets[BOTTOML][1]);
+	//bool br = Map_Solid(body, body.nextx + offsets[BOTTOMR][0], body.nexty + offsets[BOTTOMR][1]);
+
+	//tl &= Map_Tile(body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]) == '#';
+	//tr &= Map_Tile(body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]) == '#';
+	//bl &= Map_Tile(body.nextx + offsets[BOTTOML][0], body.nexty + offsets[BOTTOML][1]) == '#';
+	//br &= Map_Tile(body.nextx + offsets[BOTTOMR][0], body.nexty + offsets[BOTTOMR][1]) == '#';
+
+	//int code = (br << 3) | (bl << 2) | (tr << 1) | (tl << 0);
+	//printf("\rcode %i  (%i %i %i %i) " , code, tl, tr, bl, br);
+	//printf("code %i\n" , code);
+	//fflush(stdout);
+
+	if (code == 0x5)
+	{
+		// left	
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+		body.nextx += dx;
+		body.velx = 0;
+	}
+	else if (code == 0xa)
+	{
+		// right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) - slop;
+		body.nextx -= dx;
+		body.velx = 0;
+	}
+	else if (code == 0x3)
+	{
+		// top
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y) - slop;
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xc)
+	{
+		// bottom
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+	else if (code == 0x4)
+	{
+		// convex bottom left
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+
+		if (dx < dy)
+		{
+			// push out on x axis (left)
+			body.nextx += dx;
+			if (body.velx < 0.0f)
+				body.velx = 0;
+		}
+		else
+		{
+			// push out on y axis
+			body.nexty += dy;;
+			if (body.vely < 0.0f)
+				body.vely = 0;
+		}
+	}
+	else if (code == 0x8)
+	{
+		// convex bottom right
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) - slop;
+
+		if (dx < dy)
+		{
+			body.nextx -= dx;
+			if (body.velx > 0.0f)
+				body.velx = 0;
+		}
+		else
+		{
+			body.nexty += dy;
+			if (body.vely < 0.0f)
+				body.vely = 0;
+		}
+	}
+	else if (code == 0x1)
+	{
+		// convex top left	
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y) - slop;
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+
+		if (dx < dy)
+		{
+			body.nextx += dx;
+			if (body.velx < 0.0f)
+				body.velx = 0;
+		}
+		else
+		{
+			body.nexty -= dy;
+			if (body.vely > 0.0f)
+				body.vely = 0;
+		}
+	}
+	else if (code == 0x2)
+	{
+		// convex top right
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y) + slop;
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) + slop;
+		
+		if (dx < dy)
+		{
+			body.nextx -= dx;
+			if (body.velx > 0.0f)
+				body.velx = 0;
+		}
+		else
+		{
+			body.nexty -= dy;
+			if (body.vely > 0.0f)
+				body.vely = 0;
+		}
+	}
+	else if (code == 0x7)
+	{
+		// concave top left
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x;
+		body.nextx += dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y);
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xb)
+	{
+		// concave top right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x);
+		body.nextx -= dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y);
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xd)
+	{
+		// concave bottom left
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x;
+		body.nextx += dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+	else if (code == 0xe)
+	{
+		// concave bottom right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x);
+		body.nextx -= dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+	else if (code == 0xf)
+	{
+		body.nextx += 1;
+		body.velx = 0;
+		body.vely = 0;
+	}
+}
+
+// glsim-good's resolution: no slop on the left, right and top pushes, and a
+// convex corner only pushes out when the velocity points into it
+void Move_Clip_SolidInto(body_t &body, int code)
+{
+	static const vec_t slop = 1.0f / 16.0f;
+
+	if (code == 0x5)
+	{
+		// left
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x;
+		body.nextx += dx;
+		body.velx = 0;
+	}
+	else if (code == 0xa)
+	{
+		// right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x);
+		body.nextx -= dx;
+		body.velx = 0;
+	}
+	else if (code == 0x3)
+	{
+		// top
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y);
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xc)
+	{
+		// bottom
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+	else if (code == 0x4)
+	{
+		// convex bottom left
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+
+		if (dx < dy)
+		{
+			if (body.velx < 0.0f)
+			{
+				body.nextx += dx;
+				body.velx = 0;
+			}
+		}
+		else
+		{
+			if (body.vely < 0.0f)
+			{
+				body.nexty += dy;
+				body.vely = 0;
+			}
+		}
+	}
+	else if (code == 0x8)
+	{
+		// convex bottom right
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) - slop;
+
+		if (dx < dy)
+		{
+			if (body.velx > 0.0f)
+			{
+				body.nextx -= dx;
+				body.velx = 0;
+			}
+		}
+		else
+		{
+			if (body.vely < 0.0f)
+			{
+				body.nexty += dy;
+				body.vely = 0;
+			}
+		}
+	}
+	else if (code == 0x1)
+	{
+		// convex top left
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y) - slop;
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+
+		if (dx < dy)
+		{
+			if (body.velx < 0.0f)
+			{
+				body.nextx += dx;
+				body.velx = 0;
+			}
+		}
+		else
+		{
+			if (body.vely > 0.0f)
+			{
+				body.nexty -= dy;
+				body.vely = 0;
+			}
+		}
+	}
+	else if (code == 0x2)
+	{
+		// convex top right
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y) - slop;
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x) - slop;
+
+		if (dx < dy)
+		{
+			if (body.velx > 0.0f)
+			{
+				body.nextx -= dx;
+				body.velx = 0;
+			}
+		}
+		else
+		{
+			if (body.vely > 0.0f)
+			{
+				body.nexty -= dy;
+				body.vely = 0;
+			}
+		}
+	}
+	else if (code == 0x7)
+	{
+		// concave top left
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x;
+		body.nextx += dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y);
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xb)
+	{
+		// concave top right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x);
+		body.nextx -= dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty + 4.0;
+		vec_t dy = y - Tile_Floor(y);
+		body.nexty -= dy;
+		body.vely = 0;
+	}
+	else if (code == 0xd)
+	{
+		// concave bottom left
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x;
+		body.nextx += dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+	else if (code == 0xe)
+	{
+		// concave bottom right
+		vec_t x = body.nextx + 4.0;
+		vec_t dx = x - Tile_Floor(x);
+		body.nextx -= dx;
+		body.velx = 0;
+
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+
+	// a box buried in 0xf is left where it is
+}
+
+// This is the Move_Clip for a one-way tile
+void Move_Clip_OneWay(body_t &body, int code)
+{
+	// 16 subpixel intersection slop
+	//static const float slop = 1.0f / 64.0f;
+	static const vec_t slop = 1.0f / 16.0f;
+	//static const float slop = 0.0f;
+
+	//bool tl = Map_Solid(body, body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]);
+	//bool tr = Map_Solid(body, body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]);
+	//bool bl = Map_Solid(body, body.nextx + offsets[BOTTOML][0], body.nexty + offsets[BOTTOML][1]);
+	//bool br = Map_Solid(body, body.nextx + offsets[BOTTOMR][0], body.nexty + offsets[BOTTOMR][1]);
+
+	//tl &= Map_Tile(body.nextx + offsets[TOPL][0], body.nexty + offsets[TOPL][1]) == '1';
+	//tr &= Map_Tile(body.nextx + offsets[TOPR][0], body.nexty + offsets[TOPR][1]) == '1';
+	//bl &= Map_Tile(body.nextx + offsets[BOTTOML][0], body.nexty + offsets[BOTTOML][1]) == '1';
+	//br &= Map_Tile(body.nextx + offsets[BOTTOMR][0], body.nexty + offsets[BOTTOMR][1]) == '1';
+
+	//int code = (br << 3) | (bl << 2) | (tr << 1) | (tl << 0);
+
+	if (code == 0x7 || code == 0xb || code == 0xc || code == 0x8 || code == 0x4 || code == 0xd || code == 0xe || code == 0xf)
+	{
+		//printf("collide %i\n", code);
+		vec_t y = body.nexty - 4.0;
+		vec_t dy = Tile_Next(y) - y - slop;
+		body.nexty += dy;
+		body.vely = 0;
+	}
+}
+
+void Move_Clip_OneX(body_t &body, int code)
+{
+	static const vec_t slop = 1.0f / 16.0f;
+
+	if (code == 0x5 || code == 0x1 || code == 0x4)
+	{
+		// left	
+		vec_t x = body.nextx - 4.0;
+		vec_t dx = Tile_Next(x) - x - slop;
+		body.nextx += dx;
+		body.velx = 0;
+	}
+}
+
+// resolves the classes in order, solid last. resolving a class can move the
+// box, in which case the corners are sampled again for the following ones
+template <class collide>
+static void Move_ClipContacts(body_t &body, int codes)
+{
+	vec_t x = body.nextx;
+	vec_t y = body.nexty;
+
+	if (CONTACT_ONEWAY(codes))
+	{
+		Move_Clip_OneWay(body, CONTACT_ONEWAY(codes));
+		if (body.nextx != x || body.nexty != y)
+		{
+			codes = Move_ContactCodes<collide>(body);
+			x = body.nextx;
+			y = body.nexty;
+		}
+	}
+
+	if (CONTACT_ONEWAYX(codes))
+	{
+		Move_Clip_OneX(body, CONTACT_ONEWAYX(codes));
+		if (body.nextx != x || body.nexty != y)
+			codes = Move_ContactCodes<collide>(body);
+	}
+
+	// solid must be resolved last
+	if (!CONTACT_SOLID(codes))
+		return;
+
+	if (collide::clip == CLIP_INTO)
+		Move_Clip_SolidInto(body, CONTACT_SOLID(codes));
+	else
+		Move_Clip_Solid(body, CONTACT_SOLID(codes));
+}
+
+
+
+void Move_ClipContacts(body_t &body, int codes)
+{
+	Move_ClipContacts<batch_collide_t>(body, codes);
+}
+
+
+
+template <class collide>
+static void Move_Clip(body_t &body)
+{
+	int codes = Move_ContactCodes<collide>(body);
+
+	// nothing collidable under the box
+	if (!codes)
+		return;
+
+	Move_ClipContacts<collide>(body, codes);
+}
+
+
+
+void Move_Clip(body_t &body)
+{
+	Move_Clip<batch_collide_t>(body);
+}
+
+
+
+// --------------------------------------------------------------------------------
+// Swept movement
+//
+// Move_Clip only looks at the corners of the box at the destination, so a box
+// moving half a tile per frame can end up deep inside a wall or past it.
+// Long moves are traced through the tile edges the box crosses in order, and
+// cut short at the first one that blocks so Move_Clip only ever sees a shallow
+// penetration.
+
+#define MOVE_MAXAIR		5.0f
+#define MOVE_MAXWATER	2.0f
+#define MOVE_MAXFIELD	10.0f
+
+vec_t move_maxair = MOVE_MAXAIR;
+vec_t move_maxwater = MOVE_MAXWATER;
+vec_t move_maxfield = MOVE_MAXFIELD;
+
+static bool move_sweep = true;
+// only raised clamps are swept, the defaults keep the unswept movement that
+// recorded demos replay against (jumps and fields can still exceed SWEEP_MIN)
+static bool move_raised = false;
+
+// the leading edge is pulled in well past the clip slop, so a box resting
+// against a tile meets it again
+#define SWEEP_SKIN	(1.0f / 4.0f)
+// the sides are pulled in further, so a box resting on a floor or against a
+// wall can slide along it
+#define SWEEP_EPS	(1.0f / 2.0f)
+// contacts end this far inside the tile, where the corner samples see them
+#define SWEEP_DEPTH	(1.0f / 16.0f)
+
+void Sim_SetSpeedLimits(float air, float water, float field)
+{
+	move_maxair = air;
+	move_maxwater = water;
+	move_maxfield = field;
+	move_raised = air > MOVE_MAXAIR || water > MOVE_MAXWATER || field > MOVE_MAXFIELD;
+}
+
+
+
+void Sim_SetSweep(bool enable)
+{
+	move_sweep = enable;
+}
+
+
+
+// tiles that block a box edge crossing into them along an axis, one-way tiles
+// only stop moves in the direction they are solid in
+static bool Move_SweepBlocked(int x, int y, int flags)
+{
+	tile_t tile = Map_Tile(vec_t(x * TILE_SIZE), vec_t(y * TILE_SIZE));
+
+	return (tile & flags) != 0;
+}
+
+
+
+// first crossing of a tile edge by the leading side of the box along one axis:
+// the time of the crossing, the time between crossings, the entered tile and
+// the direction, 0 if the move never crosses
+static int Move_SweepAxis(vec_t pos, vec_t delta, vec_t &t, vec_t &dt, int &tile)
+{
+	// tiny moves are left to Move_Clip, their crossing times would overflow
+	// in fixed point
+	if (fabs(delta) < 1.0f / 64.0f)
+	{
+		t = 2.0f;
+		dt = 0.0f;
+		tile = 0;
+		return 0;
+	}
+
+	dt = vec_t(TILE_SIZE) / fabs(delta);
+
+	if (delta > 0.0f)
+	{
+		// an edge on a line is about to cross it, same as going down
+		vec_t edge = pos + 4.0f - SWEEP_SKIN;
+		vec_t line = Tile_Floor(edge);
+		if (line < edge)
+			line += vec_t(TILE_SIZE);
+
+		t = (line - edge) / delta;
+		tile = Tile_Index(line);
+		return 1;
+	}
+
+	vec_t edge = pos - 4.0f + SWEEP_SKIN;
+	vec_t line = Tile_Floor(edge);
+	t = (line - edge) / delta;
+	tile = Tile_Index(line) - 1;
+	return -1;
+}
+
+
+
+// the tiles the box spans across the move at pos: up to the last one the
+// leading side entered, the trailing side pulled in by SWEEP_EPS
+static void Move_SweepSpan(vec_t pos, int step, int next, int &lo, int &hi)
+{
+	lo = Tile_Index(pos - 4.0f + SWEEP_EPS);
+	hi = Tile_Index(pos + 4.0f - SWEEP_EPS);
+
+	if (step > 0)
+		hi = next - 1;
+	else if (step < 0)
+		lo = next + 1;
+}
+
+
+
+// DDA over the columns and rows entered by the box moving by dx, dy from x, y.
+// returns the time of the earliest blocking crossing and its axis, 0 for x
+template <class collide>
+static bool Move_SweepHit(vec_t x, vec_t y, vec_t dx, vec_t dy, vec_t &hit, int &axis)
+{
+	vec_t tx, dtx, ty, dty;
+	int col, row;
+
+	int stepx = Move_SweepAxis(x, dx, tx, dtx, col);
+	int stepy = Move_SweepAxis(y, dy, ty, dty, row);
+
+	int flagsx = (SOLID | (stepx < 0 ? ONEWAYX : 0)) & collide::tiles;
+	int flagsy = (SOLID | (stepy < 0 ? ONEWAY : 0)) & collide::tiles;
+
+	while (tx <= 1.0f || ty <= 1.0f)
+	{
+		int lo, hi;
+
+		if (tx <= ty)
+		{
+			// the column entered, over the rows the box spans at that time
+			Move_SweepSpan(y + dy * tx, stepy, row, lo, hi);
+
+			for (int r = lo; r <= hi; r++)
+			{
+				if (Move_SweepBlocked(col, r, flagsx))
+				{
+					hit = tx;
+					axis = 0;
+					return true;
+				}
+			}
+
+			col += stepx;
+			tx += dtx;
+		}
+		else
+		{
+			Move_SweepSpan(x + dx * ty, stepx, col, lo, hi);
+
+			for (int c = lo; c <= hi; c++)
+			{
+				if (Move_SweepBlocked(c, row, flagsy))
+				{
+					hit = ty;
+					axis = 1;
+					return true;
+				}
+			}
+
+			row += stepy;
+			ty += dty;
+		}
+	}
+
+	return false;
+}
+
+
+
+template <class collide>
+static void Move_Sweep(body_t &body)
+{
+	vec_t dx = body.nextx - body.objx;
+	vec_t dy = body.nexty - body.objy;
+
+	if (!move_sweep || !move_raised || (fabs(dx) <= SWEEP_MIN && fabs(dy) <= SWEEP_MIN))
+		return;
+
+	vec_t x = body.objx;
+	vec_t y = body.objy;
+
+	// stop at the first contact, then slide the rest of the way along the
+	// other axis until it blocks too
+	for (int pass = 0; pass < 2; pass++)
+	{
+		vec_t hit;
+		int axis;
+
+		if (!Move_SweepHit<collide>(x, y, dx, dy, hit, axis))
+		{
+			x += dx;
+			y += dy;
+			break;
+		}
+
+		x += dx * hit;
+		y += dy * hit;
+
+		// back out of the tile to the contact depth
+		const vec_t backoff = SWEEP_SKIN - SWEEP_DEPTH;
+		vec_t rest = 1.0f - hit;
+		if (axis == 0)
+		{
+			x += dx > 0.0f ? -backoff : backoff;
+			dx = 0.0f;
+			dy = dy * rest;
+		}
+		else
+		{
+			y += dy > 0.0f ? -backoff : backoff;
+			dx = dx * rest;
+			dy = 0.0f;
+		}
+	}
+
+	body.nextx = x;
+	body.nexty = y;
+}
+
+
+
+void Move_Sweep(body_t &body)
+{
+	Move_Sweep<batch_collide_t>(body);
+}
+
+
+
+static void Move_Air(body_t &body)
+{
+	// apply gravity
+	body.vely -= 1;
+
+	if (body.vely <= -move_maxair)
+		body.vely = -move_maxair;
+
+	// clamp the velocities
+	if (body.velx >= move_maxair)
+		body.velx = move_maxair;
+	if (body.velx <= -move_maxair)
+		body.velx = -move_maxair;
+}
+
+
+
+static void Move_Water(body_t &body)
+{
+	// apply sinking
+	body.vely -= 1.0f;
+
+	if (body.vely <= -move_maxwater)
+		body.vely = -move_maxwater;
+
+	if (body.velx >= move_maxwater)
+		body.velx = move_maxwater;
+	if (body.velx <= -move_maxwater)
+		body.velx = -move_maxwater;
+}
+
+
+
+template <class collide>
+static void Movement(body_t &body)
+{
+	int type = Map_TileType(body.objx, body.objy);
+
+	// figure out which physics to apply
+	// fixme: add explicit ladder physics
+	if (!body.ladderstate)
+	{
+		if (type & WATER)
+			Move_Water(body);
+		else
+			Move_Air(body);
+
+		// field
+		if (Map_OnContents(body.nextx, body.nexty, FIELD) && (body.vely < move_maxfield))
+			body.vely += 1.0f;
+	}
+
+	// try the move
+	body.nextx = body.objx + body.velx;
+	body.nexty = body.objy + body.vely;
+
+	// clip the move
+	Move_Sweep<collide>(body);
+	Move_Clip<collide>(body);
+
+	body.prevx = body.objx;
+	body.prevy = body.objy;
+	body.objx = body.nextx;
+	body.objy = body.nexty;
+
+	//printf("obj %f, %f\n", body.objx, body.objy);
+	// evaluate the 'ground state'
+	body.onground = Move_OnGround<collide>(body);
+	//printf("onground %s\n", (body.onground ? "yes" : "no"));
+}
+
+
+
+template <class collide>
+void Body_StepWith(body_t &body, unsigned int simframe)
+{
+	uint64_t t = Prof_Begin();
+
+	Player(body, simframe);
+	t = Prof_End(PHASE_PLAYER, t);
+
+	Movement<collide>(body);
+	Prof_End(PHASE_MOVEMENT, t);
+}
+
+
+
+void Body_Step(body_t &body, unsigned int simframe)
+{
+	Body_StepWith<sim_collide_t>(body, simframe);
+}
+
+
+
+void World_Init(world_t &world)
+{
+	memset(&world, 0, sizeof(world));
+
+	world.player.objx = mapspawn[0];
+	world.player.objy = mapspawn[1];
+}
+
+
+
+template <class collide>
+void SimRunFrameWith(world_t &world, const usercmd_t &cmd)
+{
+	//printf("===== simrunframe =====\n");
+	world.simframe++;
+	world.simtime = world.simframe * SIM_TIMESTEP;
+
+	world.player.cmd = cmd;
+
+	Body_StepWith<collide>(world.player, world.simframe);
+
+	if (mapchunked)
+		Chunk_Prefetch(world.player);
+}
+
+
+
+void SimRunFrame(world_t &world, const usercmd_t &cmd)
+{
+	SimRunFrameWith<sim_collide_t>(world, cmd);
+}
+
+template void Body_StepWith<collide_full_t>(body_t &body, unsigned int simframe);
+template void Body_StepWith<collide_oneway_t>(body_t &body, unsigned int simframe);
+template void Body_StepWith<collide_solid_t>(body_t &body, unsigned int simframe);
+template void SimRunFrameWith<collide_full_t>(world_t &world, const usercmd_t &cmd);
+template void SimRunFrameWith<collide_oneway_t>(world_t &world, const usercmd_t &cmd);
+template void SimRunFrameWith<collide_solid_t>(world_t &world, const usercmd_t &cmd);
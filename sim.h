@@ -0,0 +1,235 @@
+#ifndef SIM_H
+#define SIM_H
+
+// simulation timestep in msecs
+// eqv to 30 frames per second
+#define SIM_TIMESTEP	32
+#define TILE_SIZE	16
+#define TILE_SHIFT	4
+
+// the simulation scalar. building with SIM_FIXED makes the physics use 16.16
+// fixed point so it's deterministic across compilers and machines, convert
+// with (float) for rendering
+#ifdef SIM_FIXED
+#include "fixed.h"
+typedef fixed_t vec_t;
+#define VEC_NAME	"fixed"
+#else
+typedef float vec_t;
+#define VEC_NAME	"float"
+#endif
+
+// --------------------------------------------------------------------------------
+// Input
+
+enum keyaction_t
+{
+	ka_left,
+	ka_right,
+	ka_up,
+	ka_down,
+	ka_x,
+	ka_y,
+	NUM_KEY_ACTIONS
+};
+
+// --------------------------------------------------------------------------------
+// Simulation
+
+// move command built from the input each frame
+struct usercmd_t
+{
+	float	movex, movey;
+	bool	buttonx, buttonz;
+};
+
+// kinematic and logic state of a single player body
+struct body_t
+{
+	vec_t	prevx, prevy;
+	vec_t	objx, objy;
+	vec_t	velx, vely;
+	vec_t	nextx, nexty;
+	int		lastjump;
+	bool	ladderstate;
+	bool	onground;
+	usercmd_t	cmd;
+};
+
+// an independent simulation session, any number can exist per process
+struct world_t
+{
+	unsigned int	simframe;
+	unsigned int	simtime;
+	body_t			player;
+};
+
+// tile flags, compiled from the map characters by Map_Init
+#define	SOLID	(1 << 0)	// '#'
+#define WATER	(1 << 1)	// 'w'
+#define LADDER  (1 << 2)	// 'l'
+#define FIELD   (1 << 3)	// 'f'
+#define ONEWAY	(1 << 4)	// '1', only solid when landed on from above
+#define ONEWAYX	(1 << 5)	// 'l', only solid when entered from the right
+
+#define TILE_CONTENTS		0xff
+#define TILE_COLOR_SHIFT	8
+#define TILE_COLOR(t)		((t) >> TILE_COLOR_SHIFT)
+
+typedef unsigned short tile_t;
+
+// how solid contacts are resolved
+#define CLIP_PUSH	0		// always pushed out, see Move_Clip_Solid
+#define CLIP_INTO	1		// convex corners only when moving into them, see Move_Clip_SolidInto
+
+// collision policies. The movement code is specialised on one at compile
+// time, SimRunFrame and Body_Step use the one named by SIM_COLLIDE when
+// sim.cpp is built, collide_full_t by default
+template <int TILES, int PROBE, bool GROUNDTOP, int CLIP>
+struct collide_t
+{
+	static const int	tiles = TILES;			// SOLID, ONEWAY and ONEWAYX, the tile classes that block
+	static const int	probe = PROBE;			// depth of the ground test below the centre
+	static const bool	groundtop = GROUNDTOP;	// not on ground with the top corners in a wall
+	static const int	clip = CLIP;			// CLIP_PUSH or CLIP_INTO
+};
+
+// solid walls, '1' tiles landed on from above and 'l' tiles entered from the right
+typedef collide_t<SOLID | ONEWAY | ONEWAYX, 4, false, CLIP_PUSH> collide_full_t;
+// ladders don't block
+typedef collide_t<SOLID | ONEWAY, 4, false, CLIP_PUSH> collide_oneway_t;
+// only solid walls block, ground is tested a unit deeper and corners are
+// resolved the way glsim-good did
+typedef collide_t<SOLID, 5, true, CLIP_INTO> collide_solid_t;
+
+// --------------------------------------------------------------------------------
+// Maps
+//
+// A map file is a mapheader_t followed by width * height tiles, row major
+// from the bottom left, and one padding tile. Files are mapped read only.
+
+#define MAP_MAGIC	"PFM1"
+
+// fixed point positions must stay within 32767 units, floats keep better
+// than 1/32 unit precision
+#ifdef SIM_FIXED
+#define MAP_MAX_SIZE	2047
+#else
+#define MAP_MAX_SIZE	16384
+#endif
+
+struct mapheader_t
+{
+	char	magic[4];
+	int		width, height;		// in tiles
+	int		spawnx, spawny;		// player start, in units
+};
+
+// counters for chunked maps
+struct chunkstats_t
+{
+	unsigned int	lookups;		// tile reads that left the last chunk
+	unsigned int	cachehits;		// tile reads served by the last chunk
+	unsigned int	loads;
+	unsigned int	prefetches;		// loads handed to the loader thread
+	unsigned int	prefetchhits;	// first uses of a chunk that was loaded ahead
+	unsigned int	stalls;			// lookups that had to wait for a load
+	unsigned int	evictions;
+};
+
+// loads the built in map, must be called before simulating
+void Map_Init();
+bool Map_Load(const char *filename);
+
+// streams the map file in chunks through a pool of poolsize resident chunks,
+// at least 8, loading the ones ahead of the player on a background thread
+bool Map_LoadChunked(const char *filename, int poolsize);
+void Map_ChunkStats(chunkstats_t &stats);
+bool Map_Write(const char *filename);
+unsigned int Map_Revision();
+int Map_Width();
+int Map_Height();
+tile_t Map_Tile(vec_t x, vec_t y);
+bool Map_RegionContents(int x0, int y0, int x1, int y1, int type);
+
+void BuildMoveCommand(usercmd_t &cmd, const bool keys[NUM_KEY_ACTIONS]);
+
+// run the player logic and movement for one body
+void Body_Step(body_t &body, unsigned int simframe);
+
+void World_Init(world_t &world);
+
+// advance the world by one SIM_TIMESTEP using the given move command
+void SimRunFrame(world_t &world, const usercmd_t &cmd);
+
+// the same with the collision policy given, instantiated for the three above
+template <class collide> void Body_StepWith(body_t &body, unsigned int simframe);
+template <class collide> void SimRunFrameWith(world_t &world, const usercmd_t &cmd);
+
+// velocity clamps in units per frame, defaults 5 in air, 2 in water and 10
+// for the upward push of fields. once any clamp is above its default, moves
+// faster than the default clamps are swept through the map so they don't
+// tunnel through walls
+void Sim_SetSpeedLimits(float air, float water, float field);
+// disables the swept movement, only useful to measure what it prevents
+void Sim_SetSweep(bool enable);
+
+// --------------------------------------------------------------------------------
+// Batched simulation
+
+// structure of arrays holding many bodies that share a world's simframe,
+// stepped together by Batch_Step
+struct bodybatch_t
+{
+	int		numbodies;
+	int		maxbodies;
+
+	vec_t	*prevx, *prevy;
+	vec_t	*objx, *objy;
+	vec_t	*velx, *vely;
+	vec_t	*nextx, *nexty;
+	int		*lastjump;
+	bool	*ladderstate;
+	bool	*onground;
+
+	// move commands
+	float	*movex, *movey;
+	bool	*buttonx, *buttonz;
+
+	// per body scratch used by Batch_Step
+	int		*contents;
+	int		*codes;
+
+	// spatial hash and pair list used by Batch_Collide
+	int		*cellx, *celly;
+	int		*bucket;
+	int		*sorted;			// body indexes grouped by bucket
+	int		*bucketstart;		// hashsize + 1 entries
+	int		hashsize;			// power of two, at least twice maxbodies
+	int		(*pairs)[2];
+	int		numpairs, maxpairs;
+};
+
+void Batch_Alloc(bodybatch_t &batch, int maxbodies);
+void Batch_Free(bodybatch_t &batch);
+
+// returns the index of the new body or -1 if the batch is full
+int Batch_AddBody(bodybatch_t &batch, const body_t &body);
+void Batch_GetBody(const bodybatch_t &batch, int i, body_t &body);
+void Batch_SetBody(bodybatch_t &batch, int i, const body_t &body);
+void Batch_SetCommand(bodybatch_t &batch, int i, const usercmd_t &cmd);
+
+// equivalent to calling Body_Step on every body in the batch
+void Batch_Step(bodybatch_t &batch, unsigned int simframe);
+
+// pushes overlapping bodies apart, call after Batch_Step. the pairs are found
+// through a uniform grid hash of the bodies, or by testing every pair when
+// brute is set, which gives the same result. returns the number of pairs
+int Batch_Collide(bodybatch_t &batch, bool brute);
+
+// selects the vectorised kernels used by Batch_Step: "avx2", "sse", "scalar"
+// or "auto" for the best the cpu supports. returns false if unsupported
+bool Sim_SetKernels(const char *name);
+const char *Sim_KernelName();
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "sim_local.h"
+
+// --------------------------------------------------------------------------------
+// Batched simulation
+//
+// The bodies are stored as structure of arrays so the arithmetic phases of
+// the movement (gravity, clamping, integration) run as straight loops over
+// contiguous scalars and the clip classification runs through the vectorised
+// Move_ContactCodesBatch. The player logic and penetration resolution run per body.
+
+#define BATCH_ALIGN	64
+
+// array lengths are padded so every array starts on a BATCH_ALIGN boundary
+// and loops can run over whole vectors
+#define BATCH_PAD	16
+
+static char *Batch_Carve(char **p, int size)
+{
+	char *array = *p;
+	*p += (size + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+	return array;
+}
+
+void Batch_Alloc(bodybatch_t &batch, int maxbodies)
+{
+	memset(&batch, 0, sizeof(batch));
+
+	int n = (maxbodies + BATCH_PAD - 1) & ~(BATCH_PAD - 1);
+	int vecsize = ((n * sizeof(vec_t)) + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+	int floatsize = ((n * sizeof(float)) + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+	int intsize = ((n * sizeof(int)) + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+	int boolsize = ((n * sizeof(bool)) + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+
+	int hashsize = 1;
+	while (hashsize < 2 * n)
+		hashsize <<= 1;
+	int bucketsize = (((hashsize + 1) * sizeof(int)) + BATCH_ALIGN - 1) & ~(BATCH_ALIGN - 1);
+
+	int total = 8 * vecsize + 2 * floatsize + 7 * intsize + 4 * boolsize + bucketsize;
+
+	char *p = NULL;
+	if (posix_memalign((void**)&p, BATCH_ALIGN, total))
+		abort();
+	memset(p, 0, total);
+
+	batch.maxbodies		= maxbodies;
+	batch.prevx			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.prevy			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.objx			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.objy			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.velx			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.vely			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.nextx			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.nexty			= (vec_t*)Batch_Carve(&p, vecsize);
+	batch.movex			= (float*)Batch_Carve(&p, floatsize);
+	batch.movey			= (float*)Batch_Carve(&p, floatsize);
+	batch.lastjump		= (int*)Batch_Carve(&p, intsize);
+	batch.contents		= (int*)Batch_Carve(&p, intsize);
+	batch.codes			= (int*)Batch_Carve(&p, intsize);
+	batch.ladderstate	= (bool*)Batch_Carve(&p, boolsize);
+	batch.onground		= (bool*)Batch_Carve(&p, boolsize);
+	batch.buttonx		= (bool*)Batch_Carve(&p, boolsize);
+	batch.buttonz		= (bool*)Batch_Carve(&p, boolsize);
+	batch.cellx			= (int*)Batch_Carve(&p, intsize);
+	batch.celly			= (int*)Batch_Carve(&p, intsize);
+	batch.bucket		= (int*)Batch_Carve(&p, intsize);
+	batch.sorted		= (int*)Batch_Carve(&p, intsize);
+	batch.bucketstart	= (int*)Batch_Carve(&p, bucketsize);
+	batch.hashsize		= hashsize;
+}
+
+
+
+void Batch_Free(bodybatch_t &batch)
+{
+	// prevx is the start of the allocation
+	free(batch.prevx);
+	free(batch.pairs);
+	memset(&batch, 0, sizeof(batch));
+}
+
+
+
+int Batch_AddBody(bodybatch_t &batch, const body_t &body)
+{
+	if (batch.numbodies == batch.maxbodies)
+		return -1;
+
+	int i = batch.numbodies++;
+	Batch_SetBody(batch, i, body);
+
+	return i;
+}
+
+
+
+void Batch_GetBody(const bodybatch_t &batch, int i, body_t &body)
+{
+	body.prevx			= batch.prevx[i];
+	body.prevy			= batch.prevy[i];
+	body.objx			= batch.objx[i];
+	body.objy			= batch.objy[i];
+	body.velx			= batch.velx[i];
+	body.vely			= batch.vely[i];
+	body.nextx			= batch.nextx[i];
+	body.nexty			= batch.nexty[i];
+	body.lastjump		= batch.lastjump[i];
+	body.ladderstate	= batch.ladderstate[i];
+	body.onground		= batch.onground[i];
+	body.cmd.movex		= batch.movex[i];
+	body.cmd.movey		= batch.movey[i];
+	body.cmd.buttonx	= batch.buttonx[i];
+	body.cmd.buttonz	= batch.buttonz[i];
+}
+
+
+
+void Batch_SetBody(bodybatch_t &batch, int i, const body_t &body)
+{
+	batch.prevx[i]			= body.prevx;
+	batch.prevy[i]			= body.prevy;
+	batch.objx[i]			= body.objx;
+	batch.objy[i]			= body.objy;
+	batch.velx[i]			= body.velx;
+	batch.vely[i]			= body.vely;
+	batch.nextx[i]			= body.nextx;
+	batch.nexty[i]			= body.nexty;
+	batch.lastjump[i]		= body.lastjump;
+	batch.ladderstate[i]	= body.ladderstate;
+	batch.onground[i]		= body.onground;
+
+	Batch_SetCommand(batch, i, body.cmd);
+}
+
+
+
+void Batch_SetCommand(bodybatch_t &batch, int i, const usercmd_t &cmd)
+{
+	batch.movex[i]		= cmd.movex;
+	batch.movey[i]		= cmd.movey;
+	batch.buttonx[i]	= cmd.buttonx;
+	batch.buttonz[i]	= cmd.buttonz;
+}
+
+
+
+static void Batch_Player(bodybatch_t &batch, unsigned int simframe)
+{
+	for (int i = 0; i < batch.numbodies; i++)
+	{
+		body_t body;
+		Batch_GetBody(batch, i, body);
+
+		Player(body, simframe);
+
+		batch.velx[i]			= body.velx;
+		batch.vely[i]			= body.vely;
+		batch.lastjump[i]		= body.lastjump;
+		batch.ladderstate[i]	= body.ladderstate;
+
+		// sample the contents for the movement while the body is at hand
+		int contents = 0;
+		if (!body.ladderstate)
+		{
+			contents |= Map_TileType(body.objx, body.objy) & WATER;
+			if (Map_OnContents(body.nextx, body.nexty, FIELD))
+				contents |= FIELD;
+		}
+
+		batch.contents[i] = contents;
+	}
+}
+
+
+
+static void Batch_Clip(bodybatch_t &batch)
+{
+	int *codes = batch.codes;
+
+	Move_ContactCodesBatch(batch.objx, batch.objy, batch.nextx, batch.nexty, codes, batch.numbodies);
+
+	for (int i = 0; i < batch.numbodies; i++)
+	{
+		if (!codes[i])
+			continue;
+
+		body_t body;
+		body.objx	= batch.objx[i];
+		body.objy	= batch.objy[i];
+		body.velx	= batch.velx[i];
+		body.vely	= batch.vely[i];
+		body.nextx	= batch.nextx[i];
+		body.nexty	= batch.nexty[i];
+
+		Move_ClipContacts(body, codes[i]);
+
+		batch.velx[i]	= body.velx;
+		batch.vely[i]	= body.vely;
+		batch.nextx[i]	= body.nextx;
+		batch.nexty[i]	= body.nexty;
+	}
+}
+
+
+
+static void Batch_Movement(bodybatch_t &batch)
+{
+	int n = batch.numbodies;
+
+	// air and water physics, same as Move_Air and Move_Water, then try the move
+	vec_t *__restrict velx = batch.velx;
+	vec_t *__restrict vely = batch.vely;
+	vec_t *__restrict nextx = batch.nextx;
+	vec_t *__restrict nexty = batch.nexty;
+	const vec_t *__restrict objx = batch.objx;
+	const vec_t *__restrict objy = batch.objy;
+	const int *__restrict contents = batch.contents;
+	const bool *__restrict ladderstate = batch.ladderstate;
+
+	for (int i = 0; i < n; i++)
+	{
+		vec_t vx = velx[i];
+		vec_t vy = vely[i];
+
+		if (!ladderstate[i])
+		{
+			vec_t maxy = (contents[i] & WATER) ? move_maxwater : move_maxair;
+			vec_t maxx = maxy;
+
+			vy -= 1.0f;
+			vy = (vy <= -maxy) ? -maxy : vy;
+			vx = (vx >= maxx) ? maxx : vx;
+			vx = (vx <= -maxx) ? -maxx : vx;
+
+			// field
+			vy = ((contents[i] & FIELD) && (vy < move_maxfield)) ? vy + 1.0f : vy;
+		}
+
+		velx[i] = vx;
+		vely[i] = vy;
+		nextx[i] = objx[i] + vx;
+		nexty[i] = objy[i] + vy;
+	}
+
+	// the few long moves are swept before the clip
+	for (int i = 0; i < n; i++)
+	{
+		if (fabs(nextx[i] - objx[i]) <= SWEEP_MIN && fabs(nexty[i] - objy[i]) <= SWEEP_MIN)
+			continue;
+
+		body_t body;
+		body.objx	= objx[i];
+		body.objy	= objy[i];
+		body.nextx	= nextx[i];
+		body.nexty	= nexty[i];
+
+		Move_Sweep(body);
+
+		nextx[i]	= body.nextx;
+		nexty[i]	= body.nexty;
+	}
+
+	// classify all the bodies against all the tile classes at once, then
+	// resolve the few that touch something
+	Batch_Clip(batch);
+
+	// commit the move
+	for (int i = 0; i < n; i++)
+	{
+		batch.prevx[i] = batch.objx[i];
+		batch.prevy[i] = batch.objy[i];
+		batch.objx[i] = batch.nextx[i];
+		batch.objy[i] = batch.nexty[i];
+	}
+
+	// evaluate the 'ground state'
+	for (int i = 0; i < n; i++)
+	{
+		body_t body;
+		body.objx = body.nextx = batch.objx[i];
+		body.objy = body.nexty = batch.objy[i];
+
+		batch.onground[i] = Move_OnGround(body);
+	}
+}
+
+
+
+void Batch_Step(bodybatch_t &batch, unsigned int simframe)
+{
+	Batch_Player(batch, simframe);
+
+	Batch_Movement(batch);
+}
@@ -0,0 +1,491 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sim.h"
+#include "sim_local.h"
+
+// --------------------------------------------------------------------------------
+// Chunked maps
+//
+// The map file stays on disk and is read CHUNK_SIZE x CHUNK_SIZE tiles at a
+// time into a fixed pool of resident chunks, found through an open addressing
+// hash on the chunk coordinate. The hash and the pool belong to the sim
+// thread. A loader thread only fills the tiles of chunks it has been handed
+// and flips their state to ready, so lookups take no locks. Chunks ahead of
+// the player are queued for the loader every frame; a lookup that finds its
+// chunk missing or still loading is a stall. The least recently used ready
+// chunk is evicted when the pool is full.
+
+#define CHUNK_TILES			(CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_HASH_EMPTY	-1
+
+#define CHUNK_QUEUE			64			// must be a power of two
+#define PREFETCH_FRAMES		64			// how far ahead of the player to load
+#define PREFETCH_MARGIN		(16 * TILE_SIZE)
+#define CHUNK_MIN_POOL		8			// twice the 2x2 chunks the margin can span
+
+enum chunkstate_t
+{
+	CHUNK_FREE,
+	CHUNK_LOADING,
+	CHUNK_READY
+};
+
+struct chunk_t
+{
+	int				cx, cy;
+	int				state;			// chunkstate_t, written by the loader when loading
+	bool			prefetched;		// loaded ahead of use and not looked up yet
+	unsigned int	lastused;
+	tile_t			tiles[CHUNK_TILES];
+};
+
+bool mapchunked;
+
+static int chunkfd = -1;
+static int chunkswide, chunkshigh;
+
+static chunk_t *chunks;
+static int maxchunks;
+static int *chunkhash;				// chunk index or CHUNK_HASH_EMPTY
+static int hashsize;				// power of two, at least twice maxchunks
+static unsigned int chunkclock;		// bumped every prefetch to age the chunks
+
+// the last chunk looked up, most lookups land in the same one
+static chunk_t *lastchunk;
+
+static chunkstats_t chunkstats;
+
+// loader thread, the queue holds chunk indexes
+static pthread_t loaderthread;
+static pthread_mutex_t loaderlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loaderwake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t loaderdone = PTHREAD_COND_INITIALIZER;
+static int loaderqueue[CHUNK_QUEUE];
+static int loaderhead, loadertail;
+static bool loaderquit;
+static bool loaderrunning;
+
+// --------------------------------------------------------------------------------
+// Loading
+
+static void Chunk_Read(chunk_t *chunk)
+{
+	int x0 = chunk->cx * CHUNK_SIZE;
+	int y0 = chunk->cy * CHUNK_SIZE;
+	int w = mapwidth - x0 < CHUNK_SIZE ? mapwidth - x0 : CHUNK_SIZE;
+	int h = mapheight - y0 < CHUNK_SIZE ? mapheight - y0 : CHUNK_SIZE;
+
+	// the parts past the map edge are never read through Map_Tile
+	for (int y = 0; y < h; y++)
+	{
+		off_t offset = sizeof(mapheader_t) + ((off_t)(y0 + y) * mapwidth + x0) * sizeof(tile_t);
+		size_t size = w * sizeof(tile_t);
+
+		if (pread(chunkfd, chunk->tiles + y * CHUNK_SIZE, size, offset) != (ssize_t)size)
+		{
+			fprintf(stderr, "map: short read of chunk %i, %i\n", chunk->cx, chunk->cy);
+			memset(chunk->tiles + y * CHUNK_SIZE, 0, size);
+		}
+	}
+}
+
+
+
+static void *Chunk_LoaderThread(void *)
+{
+	pthread_mutex_lock(&loaderlock);
+
+	while (!loaderquit)
+	{
+		if (loaderhead == loadertail)
+		{
+			pthread_cond_wait(&loaderwake, &loaderlock);
+			continue;
+		}
+
+		chunk_t *chunk = &chunks[loaderqueue[loadertail & (CHUNK_QUEUE - 1)]];
+		loadertail++;
+
+		pthread_mutex_unlock(&loaderlock);
+		Chunk_Read(chunk);
+		pthread_mutex_lock(&loaderlock);
+
+		__atomic_store_n(&chunk->state, CHUNK_READY, __ATOMIC_RELEASE);
+		pthread_cond_broadcast(&loaderdone);
+	}
+
+	pthread_mutex_unlock(&loaderlock);
+
+	return NULL;
+}
+
+
+
+// false if the queue is full, the chunk is then loaded on first use
+static bool Chunk_Queue(int index)
+{
+	pthread_mutex_lock(&loaderlock);
+
+	bool queued = loaderhead - loadertail < CHUNK_QUEUE;
+	if (queued)
+	{
+		loaderqueue[loaderhead & (CHUNK_QUEUE - 1)] = index;
+		loaderhead++;
+		pthread_cond_signal(&loaderwake);
+	}
+
+	pthread_mutex_unlock(&loaderlock);
+
+	return queued;
+}
+
+
+
+static void Chunk_WaitReady(chunk_t *chunk)
+{
+	pthread_mutex_lock(&loaderlock);
+	while (__atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) != CHUNK_READY)
+		pthread_cond_wait(&loaderdone, &loaderlock);
+	pthread_mutex_unlock(&loaderlock);
+}
+
+// --------------------------------------------------------------------------------
+// Hash
+
+static unsigned int Chunk_Hash(int cx, int cy)
+{
+	return ((unsigned int)cx * 73856093u) ^ ((unsigned int)cy * 19349663u);
+}
+
+
+
+// the hash slot holding the chunk, or the empty slot where it would go
+static int Chunk_Slot(int cx, int cy)
+{
+	int slot = Chunk_Hash(cx, cy) & (hashsize - 1);
+
+	while (chunkhash[slot] != CHUNK_HASH_EMPTY)
+	{
+		const chunk_t *chunk = &chunks[chunkhash[slot]];
+		if (chunk->cx == cx && chunk->cy == cy)
+			break;
+		slot = (slot + 1) & (hashsize - 1);
+	}
+
+	return slot;
+}
+
+
+
+// backward shift deletion keeps the probe sequences intact without tombstones
+static void Chunk_Unhash(int slot)
+{
+	int next = slot;
+
+	for (;;)
+	{
+		next = (next + 1) & (hashsize - 1);
+		if (chunkhash[next] == CHUNK_HASH_EMPTY)
+			break;
+
+		const chunk_t *chunk = &chunks[chunkhash[next]];
+		int home = Chunk_Hash(chunk->cx, chunk->cy) & (hashsize - 1);
+
+		// move the entry back if its home isn't cyclically in (slot, next]
+		if (((next - home) & (hashsize - 1)) >= ((next - slot) & (hashsize - 1)))
+		{
+			chunkhash[slot] = chunkhash[next];
+			slot = next;
+		}
+	}
+
+	chunkhash[slot] = CHUNK_HASH_EMPTY;
+}
+
+
+
+// a free chunk, evicting the least recently used ready one if the pool is full
+static int Chunk_Alloc()
+{
+	int oldest = -1;
+
+	for (int i = 0; i < maxchunks; i++)
+	{
+		int state = __atomic_load_n(&chunks[i].state, __ATOMIC_ACQUIRE);
+		if (state == CHUNK_FREE)
+			return i;
+
+		if (state == CHUNK_READY &&
+			(oldest < 0 || chunks[i].lastused < chunks[oldest].lastused))
+			oldest = i;
+	}
+
+	// everything is still loading
+	if (oldest < 0)
+		return -1;
+
+	chunk_t *chunk = &chunks[oldest];
+	Chunk_Unhash(Chunk_Slot(chunk->cx, chunk->cy));
+	if (lastchunk == chunk)
+		lastchunk = NULL;
+
+	chunk->state = CHUNK_FREE;
+	chunkstats.evictions++;
+
+	return oldest;
+}
+
+
+
+// finds or creates the chunk, queueing it for the loader if prefetching or
+// reading it right away if not
+static chunk_t *Chunk_Find(int cx, int cy, bool prefetch)
+{
+	int slot = Chunk_Slot(cx, cy);
+	if (chunkhash[slot] != CHUNK_HASH_EMPTY)
+		return &chunks[chunkhash[slot]];
+
+	int index = Chunk_Alloc();
+	if (index < 0)
+	{
+		// wait for a load to finish so its chunk can be evicted
+		if (prefetch)
+			return NULL;
+
+		for (int i = 0; i < maxchunks; i++)
+			Chunk_WaitReady(&chunks[i]);
+
+		index = Chunk_Alloc();
+	}
+
+	// eviction may have moved entries
+	slot = Chunk_Slot(cx, cy);
+
+	chunk_t *chunk = &chunks[index];
+	chunk->cx = cx;
+	chunk->cy = cy;
+	chunk->lastused = chunkclock;
+	chunk->prefetched = prefetch;
+	chunkhash[slot] = index;
+	chunkstats.loads++;
+
+	if (prefetch && loaderrunning)
+	{
+		chunk->state = CHUNK_LOADING;
+		if (Chunk_Queue(index))
+		{
+			chunkstats.prefetches++;
+			return chunk;
+		}
+	}
+
+	Chunk_Read(chunk);
+	chunk->state = CHUNK_READY;
+
+	return chunk;
+}
+
+// --------------------------------------------------------------------------------
+// Map interface
+
+// the current map is only torn down once the new one is open and its pool
+// allocated, so a failed load leaves it in place
+bool Chunk_Init(const char *filename, int poolsize)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+	{
+		fprintf(stderr, "map: couldn't open %s\n", filename);
+		return false;
+	}
+
+	mapheader_t header;
+	if (pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, MAP_MAGIC, sizeof(header.magic)) ||
+		header.width <= 0 || header.height <= 0 || header.width > MAP_MAX_SIZE || header.height > MAP_MAX_SIZE)
+	{
+		fprintf(stderr, "map: %s is not a map\n", filename);
+		close(fd);
+		return false;
+	}
+
+	int newmaxchunks = poolsize > CHUNK_MIN_POOL ? poolsize : CHUNK_MIN_POOL;
+	int newhashsize;
+	for (newhashsize = 1; newhashsize < newmaxchunks * 2; newhashsize <<= 1)
+		;
+
+	chunk_t *newchunks = (chunk_t*)calloc(newmaxchunks, sizeof(chunk_t));
+	int *newhash = (int*)malloc(newhashsize * sizeof(int));
+	if (!newchunks || !newhash)
+	{
+		fprintf(stderr, "map: couldn't allocate %i chunks\n", newmaxchunks);
+		free(newchunks);
+		free(newhash);
+		close(fd);
+		return false;
+	}
+
+	Chunk_Shutdown();
+
+	chunkfd = fd;
+	mapwidth = header.width;
+	mapheight = header.height;
+	chunkswide = (mapwidth + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+	chunkshigh = (mapheight + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+
+	maxchunks = newmaxchunks;
+	hashsize = newhashsize;
+	chunks = newchunks;
+	chunkhash = newhash;
+	for (int i = 0; i < hashsize; i++)
+		chunkhash[i] = CHUNK_HASH_EMPTY;
+
+	lastchunk = NULL;
+	chunkclock = 0;
+	memset(&chunkstats, 0, sizeof(chunkstats));
+
+	loaderquit = false;
+	loaderhead = loadertail = 0;
+	loaderrunning = pthread_create(&loaderthread, NULL, Chunk_LoaderThread, NULL) == 0;
+
+	mapchunked = true;
+	mapflags = NULL;
+
+	return true;
+}
+
+
+
+void Chunk_Shutdown()
+{
+	if (!mapchunked)
+		return;
+
+	if (loaderrunning)
+	{
+		pthread_mutex_lock(&loaderlock);
+		loaderquit = true;
+		pthread_cond_signal(&loaderwake);
+		pthread_mutex_unlock(&loaderlock);
+
+		pthread_join(loaderthread, NULL);
+		loaderrunning = false;
+	}
+
+	close(chunkfd);
+	chunkfd = -1;
+
+	free(chunks);
+	free(chunkhash);
+	chunks = NULL;
+	chunkhash = NULL;
+	lastchunk = NULL;
+
+	mapchunked = false;
+}
+
+
+
+// x and y are already inside the map
+tile_t Chunk_Tile(int x, int y)
+{
+	int cx = x >> CHUNK_SHIFT;
+	int cy = y >> CHUNK_SHIFT;
+
+	chunk_t *chunk = lastchunk;
+	if (!chunk || chunk->cx != cx || chunk->cy != cy)
+	{
+		chunkstats.lookups++;
+
+		// a chunk that wasn't loaded ahead is read right here
+		unsigned int loads = chunkstats.loads;
+		chunk = Chunk_Find(cx, cy, false);
+
+		if (chunkstats.loads != loads)
+			chunkstats.stalls++;
+		else if (__atomic_load_n(&chunk->state, __ATOMIC_ACQUIRE) != CHUNK_READY)
+		{
+			chunkstats.stalls++;
+			Chunk_WaitReady(chunk);
+		}
+		else if (chunk->prefetched)
+			chunkstats.prefetchhits++;
+
+		chunk->prefetched = false;
+		chunk->lastused = chunkclock;
+
+		lastchunk = chunk;
+	}
+	else
+		chunkstats.cachehits++;
+
+	return chunk->tiles[((y & (CHUNK_SIZE - 1)) << CHUNK_SHIFT) + (x & (CHUNK_SIZE - 1))];
+}
+
+
+
+// the chunks between the body and where it will be in frames frames, with a
+// margin around them, clipped to the map
+static void Chunk_PrefetchRegion(const body_t &body, int frames, int &cx0, int &cy0, int &cx1, int &cy1)
+{
+	float x = (float)body.objx;
+	float y = (float)body.objy;
+	float ax = x + (float)body.velx * frames;
+	float ay = y + (float)body.vely * frames;
+
+	int x0 = (int)((x < ax ? x : ax) - PREFETCH_MARGIN) / TILE_SIZE;
+	int x1 = (int)((x > ax ? x : ax) + PREFETCH_MARGIN) / TILE_SIZE;
+	int y0 = (int)((y < ay ? y : ay) - PREFETCH_MARGIN) / TILE_SIZE;
+	int y1 = (int)((y > ay ? y : ay) + PREFETCH_MARGIN) / TILE_SIZE;
+
+	cx0 = x0 < 0 ? 0 : x0 >> CHUNK_SHIFT;
+	cy0 = y0 < 0 ? 0 : y0 >> CHUNK_SHIFT;
+	cx1 = (x1 >> CHUNK_SHIFT) < chunkswide ? x1 >> CHUNK_SHIFT : chunkswide - 1;
+	cy1 = (y1 >> CHUNK_SHIFT) < chunkshigh ? y1 >> CHUNK_SHIFT : chunkshigh - 1;
+}
+
+
+
+// queues the chunks between the body and where it will be in PREFETCH_FRAMES
+// frames. Fast bodies look less far ahead, so the region never takes more
+// than half the pool and the chunks around the body aren't evicted by the
+// ones it's heading for.
+void Chunk_Prefetch(const body_t &body)
+{
+	chunkclock++;
+
+	int budget = maxchunks / 2;
+	int cx0, cy0, cx1, cy1;
+
+	for (int frames = PREFETCH_FRAMES; ; frames /= 2)
+	{
+		Chunk_PrefetchRegion(body, frames, cx0, cy0, cx1, cy1);
+
+		// the margin alone spans at most 2x2 chunks, which CHUNK_MIN_POOL
+		// keeps within the budget
+		if (!frames || (cx1 - cx0 + 1) * (cy1 - cy0 + 1) <= budget)
+			break;
+	}
+
+	for (int cy = cy0; cy <= cy1; cy++)
+	{
+		for (int cx = cx0; cx <= cx1; cx++)
+		{
+			chunk_t *chunk = Chunk_Find(cx, cy, true);
+
+			// keep the chunks the body is heading for from being evicted
+			if (chunk)
+				chunk->lastused = chunkclock;
+		}
+	}
+}
+
+
+
+void Map_ChunkStats(chunkstats_t &stats)
+{
+	stats = chunkstats;
+}
@@ -0,0 +1,247 @@
+#include <stdlib.h>
+#include "sim.h"
+#include "sim_local.h"
+
+// --------------------------------------------------------------------------------
+// Body collision
+//
+// Every body is binned by the tile its centre is in. The cells are hashed into
+// the batch's buckets and the bodies grouped by bucket with a counting sort,
+// so building the grid is linear. A tile is wider than a body, so the bodies
+// overlapping one are all in the 3x3 cells around it. The pairs are listed in
+// body order and resolved one after the other the way Move_Clip_Solid pushes a
+// box out of a tile: along the axis of least penetration, stopping the
+// velocity into the contact. Half the push goes to each body, which is then
+// clipped against the map again so it can't be pushed into a wall, and its
+// ground state redone.
+
+#define BODY_SIZE	8
+
+static inline int Collide_Hash(int cx, int cy, int hashsize)
+{
+	return ((unsigned int)cx * 73856093u ^ (unsigned int)cy * 19349663u) & (hashsize - 1);
+}
+
+
+
+static inline bool Collide_Overlap(const bodybatch_t &batch, int a, int b)
+{
+	return fabs(batch.objx[a] - batch.objx[b]) < vec_t(BODY_SIZE) &&
+		fabs(batch.objy[a] - batch.objy[b]) < vec_t(BODY_SIZE);
+}
+
+
+
+static void Collide_AddPair(bodybatch_t &batch, int a, int b)
+{
+	if (batch.numpairs == batch.maxpairs)
+	{
+		batch.maxpairs = batch.maxpairs ? batch.maxpairs * 2 : 256;
+		batch.pairs = (int(*)[2])realloc(batch.pairs, batch.maxpairs * sizeof(batch.pairs[0]));
+		if (!batch.pairs)
+			abort();
+	}
+
+	batch.pairs[batch.numpairs][0] = a;
+	batch.pairs[batch.numpairs][1] = b;
+	batch.numpairs++;
+}
+
+
+
+static void Collide_BuildGrid(bodybatch_t &batch)
+{
+	int n = batch.numbodies;
+	int *start = batch.bucketstart;
+
+	for (int h = 0; h <= batch.hashsize; h++)
+		start[h] = 0;
+
+	for (int i = 0; i < n; i++)
+	{
+		batch.cellx[i] = Tile_Index(batch.objx[i]);
+		batch.celly[i] = Tile_Index(batch.objy[i]);
+		batch.bucket[i] = Collide_Hash(batch.cellx[i], batch.celly[i], batch.hashsize);
+		start[batch.bucket[i] + 1]++;
+	}
+
+	for (int h = 0; h < batch.hashsize; h++)
+		start[h + 1] += start[h];
+
+	// bodies land in index order inside each bucket, start[h] ends up at the
+	// end of bucket h and is moved back
+	for (int i = 0; i < n; i++)
+		batch.sorted[start[batch.bucket[i]]++] = i;
+
+	for (int h = batch.hashsize; h > 0; h--)
+		start[h] = start[h - 1];
+	start[0] = 0;
+}
+
+
+
+static void Collide_FindPairs(bodybatch_t &batch)
+{
+	Collide_BuildGrid(batch);
+
+	for (int a = 0; a < batch.numbodies; a++)
+	{
+		int first = batch.numpairs;
+
+		for (int cy = batch.celly[a] - 1; cy <= batch.celly[a] + 1; cy++)
+		{
+			for (int cx = batch.cellx[a] - 1; cx <= batch.cellx[a] + 1; cx++)
+			{
+				int h = Collide_Hash(cx, cy, batch.hashsize);
+
+				for (int k = batch.bucketstart[h]; k < batch.bucketstart[h + 1]; k++)
+				{
+					int b = batch.sorted[k];
+
+					// other cells share the bucket
+					if (b <= a || batch.cellx[b] != cx || batch.celly[b] != cy)
+						continue;
+
+					if (Collide_Overlap(batch, a, b))
+						Collide_AddPair(batch, a, b);
+				}
+			}
+		}
+
+		// put the pairs of a in body order, there are only ever a few
+		for (int i = first + 1; i < batch.numpairs; i++)
+		{
+			int b = batch.pairs[i][1];
+			int j = i;
+
+			for ( ; j > first && batch.pairs[j - 1][1] > b; j--)
+				batch.pairs[j][1] = batch.pairs[j - 1][1];
+
+			batch.pairs[j][1] = b;
+		}
+	}
+}
+
+
+
+static void Collide_FindPairsBrute(bodybatch_t &batch)
+{
+	for (int a = 0; a < batch.numbodies; a++)
+	{
+		for (int b = a + 1; b < batch.numbodies; b++)
+		{
+			if (Collide_Overlap(batch, a, b))
+				Collide_AddPair(batch, a, b);
+		}
+	}
+}
+
+
+
+// clips the push from fromx, fromy the way Movement clips a move
+static void Collide_Clip(bodybatch_t &batch, int i, vec_t fromx, vec_t fromy)
+{
+	body_t body;
+	Batch_GetBody(batch, i, body);
+
+	body.objx = fromx;
+	body.objy = fromy;
+	body.nextx = batch.objx[i];
+	body.nexty = batch.objy[i];
+
+	Move_Clip(body);
+
+	body.objx = body.nextx;
+	body.objy = body.nexty;
+	body.onground = Move_OnGround(body);
+
+	Batch_SetBody(batch, i, body);
+}
+
+
+
+static void Collide_Resolve(bodybatch_t &batch, int a, int b)
+{
+	vec_t ax = batch.objx[a];
+	vec_t ay = batch.objy[a];
+	vec_t bx = batch.objx[b];
+	vec_t by = batch.objy[b];
+	vec_t dx = batch.objx[b] - batch.objx[a];
+	vec_t dy = batch.objy[b] - batch.objy[a];
+	vec_t penx = vec_t(BODY_SIZE) - fabs(dx);
+	vec_t peny = vec_t(BODY_SIZE) - fabs(dy);
+
+	// an earlier push may have separated them
+	if (penx <= 0.0f || peny <= 0.0f)
+		return;
+
+	if (penx < peny)
+	{
+		// b goes right when it's not left of a
+		vec_t push = penx * 0.5f;
+		if (dx < 0.0f)
+			push = -push;
+
+		batch.objx[a] -= push;
+		batch.objx[b] += push;
+
+		if (dx >= 0.0f)
+		{
+			if (batch.velx[a] > 0.0f)
+				batch.velx[a] = 0;
+			if (batch.velx[b] < 0.0f)
+				batch.velx[b] = 0;
+		}
+		else
+		{
+			if (batch.velx[a] < 0.0f)
+				batch.velx[a] = 0;
+			if (batch.velx[b] > 0.0f)
+				batch.velx[b] = 0;
+		}
+	}
+	else
+	{
+		vec_t push = peny * 0.5f;
+		if (dy < 0.0f)
+			push = -push;
+
+		batch.objy[a] -= push;
+		batch.objy[b] += push;
+
+		if (dy >= 0.0f)
+		{
+			if (batch.vely[a] > 0.0f)
+				batch.vely[a] = 0;
+			if (batch.vely[b] < 0.0f)
+				batch.vely[b] = 0;
+		}
+		else
+		{
+			if (batch.vely[a] < 0.0f)
+				batch.vely[a] = 0;
+			if (batch.vely[b] > 0.0f)
+				batch.vely[b] = 0;
+		}
+	}
+
+	Collide_Clip(batch, a, ax, ay);
+	Collide_Clip(batch, b, bx, by);
+}
+
+
+
+int Batch_Collide(bodybatch_t &batch, bool brute)
+{
+	batch.numpairs = 0;
+
+	if (brute)
+		Collide_FindPairsBrute(batch);
+	else
+		Collide_FindPairs(batch);
+
+	for (int i = 0; i < batch.numpairs; i++)
+		Collide_Resolve(batch, batch.pairs[i][0], batch.pairs[i][1]);
+
+	return batch.numpairs;
+}
@@ -0,0 +1,97 @@
+#ifndef SIM_LOCAL_H
+#define SIM_LOCAL_H
+
+// simulation internals shared between the scalar and batched paths. the ones
+// that collide always use collide_full_t, whatever SIM_COLLIDE is
+
+#include <math.h>
+
+#define BUILTIN_MAP_SIZE	16
+
+// the tile flags with a bit layer
+#define NUM_LAYERS	6
+#define LAYER_FLAGS	((1 << NUM_LAYERS) - 1)
+
+// what Map_Tile returns outside the map
+#define MAP_OUTSIDE	(SOLID | (0 << TILE_COLOR_SHIFT))
+
+extern const tile_t *mapflags;		// NULL when the map is chunked
+extern int mapwidth;
+extern int mapheight;
+
+// chunked maps, see sim_chunks.cpp
+#define CHUNK_SHIFT	6
+#define CHUNK_SIZE	(1 << CHUNK_SHIFT)
+
+extern bool mapchunked;
+
+bool Chunk_Init(const char *filename, int poolsize);
+void Chunk_Shutdown();
+tile_t Chunk_Tile(int x, int y);
+void Chunk_Prefetch(const body_t &body);
+
+// tile coordinates and edges of a position, shifts and masks in fixed point
+#ifdef SIM_FIXED
+#define TILE_MASK	(~((TILE_SIZE << FIXED_SHIFT) - 1))
+
+static inline int Tile_Index(vec_t x) { return x.raw >> (FIXED_SHIFT + TILE_SHIFT); }
+static inline vec_t Tile_Floor(vec_t x) { return fixed_t::FromRaw(x.raw & TILE_MASK); }
+static inline vec_t Tile_Next(vec_t x) { return fixed_t::FromRaw((x.raw & TILE_MASK) + (TILE_SIZE << FIXED_SHIFT)); }
+#else
+static inline int Tile_Index(vec_t x) { return x / 16; }
+static inline vec_t Tile_Floor(vec_t x) { return (floor(x / 16.0f) * 16.0f); }
+static inline vec_t Tile_Next(vec_t x) { return ((floor(x / 16.0f) + 1) * 16.0f); }
+#endif
+
+int Map_TileType(vec_t x, vec_t y);
+bool Map_OnContents(vec_t x, vec_t y, int type);
+bool Map_OneWayCrossed(vec_t cur, vec_t next);
+bool Map_SolidTile(const body_t &body, tile_t tile);
+bool Map_Solid(const body_t &body, vec_t x, vec_t y);
+
+void Player(body_t &body, unsigned int simframe);
+
+// 4 bit corner code of the solid tiles with the type flag (SOLID, ONEWAY or
+// ONEWAYX) under the box at nextx, nexty: bit 0 top left, 1 top right,
+// 2 bottom left, 3 bottom right
+int Move_ClipCode(const body_t &body, int type);
+
+// the corner codes of all the tile classes packed together
+#define CONTACT_SOLID_BIT		(1 << 0)
+#define CONTACT_ONEWAY_BIT		(1 << 4)
+#define CONTACT_ONEWAYX_BIT		(1 << 8)
+#define CONTACT_SOLID(c)		((c) & 0xf)
+#define CONTACT_ONEWAY(c)		(((c) >> 4) & 0xf)
+#define CONTACT_ONEWAYX(c)		(((c) >> 8) & 0xf)
+
+int Move_ContactCodes(const body_t &body);
+
+// computes Move_ContactCodes for n bodies stored as arrays, vectorised when
+// the cpu allows it
+void Move_ContactCodesBatch(const vec_t *objx, const vec_t *objy, const vec_t *nextx, const vec_t *nexty, int *codes, int n);
+
+// resolve the penetration for a precomputed clip code
+void Move_Clip_OneWay(body_t &body, int code);
+void Move_Clip_OneX(body_t &body, int code);
+void Move_Clip_Solid(body_t &body, int code);
+void Move_Clip_SolidInto(body_t &body, int code);
+
+// resolves precomputed contact codes, same as Move_Clip
+void Move_ClipContacts(body_t &body, int codes);
+void Move_Clip(body_t &body);
+bool Move_OnGround(const body_t &body);
+
+// velocity clamps, see Sim_SetSpeedLimits
+extern vec_t move_maxair;
+extern vec_t move_maxwater;
+extern vec_t move_maxfield;
+
+// Move_Clip alone resolves moves up to the default clamps, longer ones are
+// swept first once Sim_SetSpeedLimits has raised the clamps
+#define SWEEP_MIN	5.0f
+
+// cuts nextx, nexty short at the earliest blocking tile edge crossed on the
+// way from objx, objy when the move is too long for Move_Clip alone
+void Move_Sweep(body_t &body);
+
+#endif
@@ -0,0 +1,308 @@
+#include <string.h>
+#include <immintrin.h>
+#include "sim.h"
+#include "sim_local.h"
+
+// --------------------------------------------------------------------------------
+// Vectorised clip classification
+//
+// Move_ContactCodes samples the four corners of the box and classifies them
+// against every tile class. SOLID tiles always collide, the one way tiles
+// collide when the body's current and next position cross the tile edge,
+// which doesn't depend on the corner, so each class code is the flag test of
+// the four corners masked by a single per body condition. This evaluates
+// that for 8 (AVX2) or 4 (SSE4.1) bodies at a time, gathering the tiles
+// straight from mapflags. The batch collides with collide_full_t, so all
+// three classes are tested.
+
+typedef void (*clipcodesfunc_t)(const vec_t *objx, const vec_t *objy, const vec_t *nextx, const vec_t *nexty, int *codes, int i, int n);
+
+static void ClipCodes_Scalar(const vec_t *objx, const vec_t *objy, const vec_t *nextx, const vec_t *nexty, int *codes, int i, int n)
+{
+	for (; i < n; i++)
+	{
+		body_t body;
+		body.objx = objx[i];
+		body.objy = objy[i];
+		body.nextx = nextx[i];
+		body.nexty = nexty[i];
+
+		codes[i] = Move_ContactCodes(body);
+	}
+}
+
+// the vector kernels work on floats, fixed point builds only have the scalar
+// path
+#ifndef SIM_FIXED
+
+// all ones in the lanes whose tile is inside the map
+#define TILE_INSIDE(x, y, simd, si) \
+	simd##_and_##si( \
+		simd##_and_##si(simd##_cmpgt_epi32(x, minusone), simd##_cmpgt_epi32(width, x)), \
+		simd##_and_##si(simd##_cmpgt_epi32(y, minusone), simd##_cmpgt_epi32(height, y)))
+
+// the tile address of each lane, lanes outside the map address tile 0 and
+// take MAP_OUTSIDE instead
+#define TILE_ADDR(x, y, inside, simd, si) \
+	simd##_and_##si(simd##_add_epi32(simd##_mullo_epi32(y, width), x), inside)
+
+// the contact bits of one corner for all the classes
+#define TILE_BITS(t, corner, simd, si) \
+	simd##_or_##si(simd##_or_##si( \
+		simd##_andnot_##si(simd##_cmpeq_epi32(simd##_and_##si(t, solid), zero), simd##_set1_epi32(CONTACT_SOLID_BIT << corner)), \
+		simd##_andnot_##si(simd##_cmpeq_epi32(simd##_and_##si(t, oneway), zero), simd##_set1_epi32(CONTACT_ONEWAY_BIT << corner))), \
+		simd##_andnot_##si(simd##_cmpeq_epi32(simd##_and_##si(t, onewayx), zero), simd##_set1_epi32(CONTACT_ONEWAYX_BIT << corner)))
+
+__attribute__((target("avx2")))
+static __m256 OneWayCrossed_AVX2(__m256 cur, __m256 next)
+{
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256 slop = _mm256_set1_ps(1.0f / 16.0f);
+
+	__m256 u = _mm256_sub_ps(cur, four);
+	__m256 v = _mm256_sub_ps(next, four);
+
+	__m256 line1 = _mm256_floor_ps(_mm256_mul_ps(v, _mm256_set1_ps(1.0f / 16.0f)));
+	line1 = _mm256_mul_ps(_mm256_add_ps(line1, _mm256_set1_ps(1.0f)), _mm256_set1_ps(16.0f));
+	__m256 line2 = _mm256_sub_ps(line1, slop);
+
+	__m256 crossed = _mm256_and_ps(_mm256_cmp_ps(u, v, _CMP_GE_OQ), _mm256_cmp_ps(u, line2, _CMP_GE_OQ));
+	return _mm256_and_ps(crossed, _mm256_cmp_ps(v, line1, _CMP_LE_OQ));
+}
+
+__attribute__((target("avx2")))
+static void ClipCodes_AVX2(const float *objx, const float *objy, const float *nextx, const float *nexty, int *codes, int i, int n)
+{
+	const __m256 scale = _mm256_set1_ps(1.0f / 16.0f);
+	const __m256 four = _mm256_set1_ps(4.0f);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i minusone = _mm256_set1_epi32(-1);
+	const __m256i width = _mm256_set1_epi32(mapwidth);
+	const __m256i height = _mm256_set1_epi32(mapheight);
+	const __m256i outside = _mm256_set1_epi32(MAP_OUTSIDE);
+	const int *tiles = (const int*)mapflags;
+
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 nx = _mm256_loadu_ps(nextx + i);
+		__m256 ny = _mm256_loadu_ps(nexty + i);
+
+		__m256i xl = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(nx, four), scale));
+		__m256i xr = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(nx, four), scale));
+		__m256i yb = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(ny, four), scale));
+		__m256i yt = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(ny, four), scale));
+
+		__m256i intl = TILE_INSIDE(xl, yt, _mm256, si256);
+		__m256i intr = TILE_INSIDE(xr, yt, _mm256, si256);
+		__m256i inbl = TILE_INSIDE(xl, yb, _mm256, si256);
+		__m256i inbr = TILE_INSIDE(xr, yb, _mm256, si256);
+
+		// 32 bit gathers of the 16 bit tiles, the upper half belongs to the next
+		// tile and is masked off by the flag tests
+		__m256i tl = _mm256_mask_i32gather_epi32(outside, tiles, TILE_ADDR(xl, yt, intl, _mm256, si256), intl, 2);
+		__m256i tr = _mm256_mask_i32gather_epi32(outside, tiles, TILE_ADDR(xr, yt, intr, _mm256, si256), intr, 2);
+		__m256i bl = _mm256_mask_i32gather_epi32(outside, tiles, TILE_ADDR(xl, yb, inbl, _mm256, si256), inbl, 2);
+		__m256i br = _mm256_mask_i32gather_epi32(outside, tiles, TILE_ADDR(xr, yb, inbr, _mm256, si256), inbr, 2);
+
+		// most bodies touch nothing collidable
+		__m256i contents = _mm256_or_si256(_mm256_or_si256(tl, tr), _mm256_or_si256(bl, br));
+		contents = _mm256_and_si256(contents, _mm256_set1_epi32(SOLID | ONEWAY | ONEWAYX));
+		if (_mm256_testz_si256(contents, contents))
+		{
+			_mm256_storeu_si256((__m256i*)(codes + i), zero);
+			continue;
+		}
+
+		const __m256i solid = _mm256_set1_epi32(SOLID);
+		__m256i oneway = _mm256_and_si256(_mm256_castps_si256(OneWayCrossed_AVX2(_mm256_loadu_ps(objy + i), ny)), _mm256_set1_epi32(ONEWAY));
+		__m256i onewayx = _mm256_and_si256(_mm256_castps_si256(OneWayCrossed_AVX2(_mm256_loadu_ps(objx + i), nx)), _mm256_set1_epi32(ONEWAYX));
+
+		__m256i code = TILE_BITS(tl, 0, _mm256, si256);
+		code = _mm256_or_si256(code, TILE_BITS(tr, 1, _mm256, si256));
+		code = _mm256_or_si256(code, TILE_BITS(bl, 2, _mm256, si256));
+		code = _mm256_or_si256(code, TILE_BITS(br, 3, _mm256, si256));
+
+		_mm256_storeu_si256((__m256i*)(codes + i), code);
+	}
+
+	ClipCodes_Scalar(objx, objy, nextx, nexty, codes, i, n);
+}
+
+__attribute__((target("sse4.1")))
+static __m128 OneWayCrossed_SSE(__m128 cur, __m128 next)
+{
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128 slop = _mm_set1_ps(1.0f / 16.0f);
+
+	__m128 u = _mm_sub_ps(cur, four);
+	__m128 v = _mm_sub_ps(next, four);
+
+	__m128 line1 = _mm_floor_ps(_mm_mul_ps(v, _mm_set1_ps(1.0f / 16.0f)));
+	line1 = _mm_mul_ps(_mm_add_ps(line1, _mm_set1_ps(1.0f)), _mm_set1_ps(16.0f));
+	__m128 line2 = _mm_sub_ps(line1, slop);
+
+	__m128 crossed = _mm_and_ps(_mm_cmpge_ps(u, v), _mm_cmpge_ps(u, line2));
+	return _mm_and_ps(crossed, _mm_cmple_ps(v, line1));
+}
+
+__attribute__((target("sse4.1")))
+static void ClipCodes_SSE(const float *objx, const float *objy, const float *nextx, const float *nexty, int *codes, int i, int n)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 16.0f);
+	const __m128 four = _mm_set1_ps(4.0f);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i minusone = _mm_set1_epi32(-1);
+	const __m128i width = _mm_set1_epi32(mapwidth);
+	const __m128i height = _mm_set1_epi32(mapheight);
+	const __m128i outside = _mm_set1_epi32(MAP_OUTSIDE);
+
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 nx = _mm_loadu_ps(nextx + i);
+		__m128 ny = _mm_loadu_ps(nexty + i);
+
+		__m128i xl = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(nx, four), scale));
+		__m128i xr = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(nx, four), scale));
+		__m128i yb = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(ny, four), scale));
+		__m128i yt = _mm_cvttps_epi32(_mm_mul_ps(_mm_add_ps(ny, four), scale));
+
+		__m128i inside[4];
+		inside[0] = TILE_INSIDE(xl, yt, _mm, si128);
+		inside[1] = TILE_INSIDE(xr, yt, _mm, si128);
+		inside[2] = TILE_INSIDE(xl, yb, _mm, si128);
+		inside[3] = TILE_INSIDE(xr, yb, _mm, si128);
+
+		// no gather before AVX2, load the lanes one at a time
+		int addr[4][4];
+		_mm_storeu_si128((__m128i*)addr[0], TILE_ADDR(xl, yt, inside[0], _mm, si128));
+		_mm_storeu_si128((__m128i*)addr[1], TILE_ADDR(xr, yt, inside[1], _mm, si128));
+		_mm_storeu_si128((__m128i*)addr[2], TILE_ADDR(xl, yb, inside[2], _mm, si128));
+		_mm_storeu_si128((__m128i*)addr[3], TILE_ADDR(xr, yb, inside[3], _mm, si128));
+
+		__m128i t[4];
+		for (int c = 0; c < 4; c++)
+		{
+			t[c] = _mm_setr_epi32(mapflags[addr[c][0]], mapflags[addr[c][1]], mapflags[addr[c][2]], mapflags[addr[c][3]]);
+			t[c] = _mm_blendv_epi8(outside, t[c], inside[c]);
+		}
+
+		// most bodies touch nothing collidable
+		__m128i contents = _mm_or_si128(_mm_or_si128(t[0], t[1]), _mm_or_si128(t[2], t[3]));
+		contents = _mm_and_si128(contents, _mm_set1_epi32(SOLID | ONEWAY | ONEWAYX));
+		if (_mm_testz_si128(contents, contents))
+		{
+			_mm_storeu_si128((__m128i*)(codes + i), zero);
+			continue;
+		}
+
+		const __m128i solid = _mm_set1_epi32(SOLID);
+		__m128i oneway = _mm_and_si128(_mm_castps_si128(OneWayCrossed_SSE(_mm_loadu_ps(objy + i), ny)), _mm_set1_epi32(ONEWAY));
+		__m128i onewayx = _mm_and_si128(_mm_castps_si128(OneWayCrossed_SSE(_mm_loadu_ps(objx + i), nx)), _mm_set1_epi32(ONEWAYX));
+
+		__m128i code = TILE_BITS(t[0], 0, _mm, si128);
+		code = _mm_or_si128(code, TILE_BITS(t[1], 1, _mm, si128));
+		code = _mm_or_si128(code, TILE_BITS(t[2], 2, _mm, si128));
+		code = _mm_or_si128(code, TILE_BITS(t[3], 3, _mm, si128));
+
+		_mm_storeu_si128((__m128i*)(codes + i), code);
+	}
+
+	ClipCodes_Scalar(objx, objy, nextx, nexty, codes, i, n);
+}
+
+#endif
+
+// --------------------------------------------------------------------------------
+// Kernel selection
+
+struct kernel_t
+{
+	const char		*name;
+	const char		*cpufeature;
+	clipcodesfunc_t	clipcodes;
+};
+
+// best first
+static const kernel_t kernels[] =
+{
+#ifndef SIM_FIXED
+	{ "avx2",	"avx2",		ClipCodes_AVX2 },
+	{ "sse",	"sse4.1",	ClipCodes_SSE },
+#endif
+	{ "scalar",	NULL,		ClipCodes_Scalar },
+};
+
+#define NUM_KERNELS	(int)(sizeof(kernels) / sizeof(kernels[0]))
+
+static const kernel_t *kernel;
+static bool kernelsinitialized;
+
+static bool Kernel_Supported(const kernel_t *k)
+{
+	if (!k->cpufeature)
+		return true;
+
+	// __builtin_cpu_supports only takes string literals
+	if (!strcmp(k->cpufeature, "avx2"))
+		return __builtin_cpu_supports("avx2");
+	if (!strcmp(k->cpufeature, "sse4.1"))
+		return __builtin_cpu_supports("sse4.1");
+
+	return false;
+}
+
+static void Kernel_Init()
+{
+	if (kernelsinitialized)
+		return;
+
+	__builtin_cpu_init();
+	kernelsinitialized = true;
+}
+
+
+
+bool Sim_SetKernels(const char *name)
+{
+	Kernel_Init();
+
+	for (int i = 0; i < NUM_KERNELS; i++)
+	{
+		if (strcmp(name, "auto") && strcmp(name, kernels[i].name))
+			continue;
+		if (!Kernel_Supported(&kernels[i]))
+			continue;
+
+		kernel = &kernels[i];
+		return true;
+	}
+
+	return false;
+}
+
+
+
+const char *Sim_KernelName()
+{
+	if (!kernel)
+		Sim_SetKernels("auto");
+
+	return kernel->name;
+}
+
+
+
+void Move_ContactCodesBatch(const vec_t *objx, const vec_t *objy, const vec_t *nextx, const vec_t *nexty, int *codes, int n)
+{
+	if (!kernel)
+		Sim_SetKernels("auto");
+
+	// the vector kernels read the flat tile array
+	if (mapchunked)
+	{
+		ClipCodes_Scalar(objx, objy, nextx, nexty, codes, 0, n);
+		return;
+	}
+
+	kernel->clipcodes(objx, objy, nextx, nexty, codes, 0, n);
+}
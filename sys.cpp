@@ -0,0 +1,56 @@
+#include <sys/resource.h>
+#include <time.h>
+#include <errno.h>
+#include <stddef.h>
+#include "sys.h"
+
+// monotonic, so it never jumps with wall clock adjustments
+uint64_t Sys_Nanoseconds(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+
+// milliseconds since the first call
+unsigned int Sys_Milliseconds(void)
+{
+	static uint64_t	base;
+
+	uint64_t now = Sys_Nanoseconds();
+	if (!base)
+		base = now;
+
+	return (unsigned int)((now - base) / 1000000);
+}
+
+
+
+// blocks on the monotonic clock, so wall clock adjustments don't stretch it
+void Sys_Sleep(unsigned int msecs)
+{
+	struct timespec	ts;
+
+	ts.tv_sec = msecs / 1000;
+	ts.tv_nsec = (msecs % 1000) * 1000000;
+
+	// resume with the remaining time after a signal
+	while (clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, &ts) == EINTR)
+		;
+}
+
+
+
+// user and system cpu time used by the process
+unsigned int Sys_CpuMilliseconds(void)
+{
+	struct rusage	ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000 + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+}
@@ -0,0 +1,11 @@
+#ifndef SYS_H
+#define SYS_H
+
+#include <stdint.h>
+
+uint64_t Sys_Nanoseconds(void);
+unsigned int Sys_Milliseconds(void);
+void Sys_Sleep(unsigned int msecs);
+unsigned int Sys_CpuMilliseconds(void);
+
+#endif
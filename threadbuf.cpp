@@ -0,0 +1,100 @@
+#include <string.h>
+#include "threadbuf.h"
+
+// --------------------------------------------------------------------------------
+// Key queue
+//
+// head and tail only ever grow and wrap through the mask. The release store
+// of an index publishes the slots written before it.
+
+void KeyQueue_Init(keyqueue_t &queue)
+{
+	memset(&queue, 0, sizeof(queue));
+}
+
+
+
+bool KeyQueue_Push(keyqueue_t &queue, int action, bool down)
+{
+	unsigned int head = queue.head;
+	unsigned int tail = __atomic_load_n(&queue.tail, __ATOMIC_ACQUIRE);
+
+	if (head - tail == KEY_QUEUE_SIZE)
+		return false;
+
+	keyevent_t &event = queue.events[head & (KEY_QUEUE_SIZE - 1)];
+	event.action = (unsigned char)action;
+	event.down = down;
+
+	__atomic_store_n(&queue.head, head + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+
+
+bool KeyQueue_Pop(keyqueue_t &queue, keyevent_t &event)
+{
+	unsigned int tail = queue.tail;
+	unsigned int head = __atomic_load_n(&queue.head, __ATOMIC_ACQUIRE);
+
+	if (tail == head)
+		return false;
+
+	event = queue.events[tail & (KEY_QUEUE_SIZE - 1)];
+
+	__atomic_store_n(&queue.tail, tail + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+// --------------------------------------------------------------------------------
+// Render buffer
+//
+// The three slot indexes are always a permutation of 0, 1, 2. Swapping the
+// middle index is the only shared write, the acquire and release on it order
+// the slot contents.
+
+void RenderBuffer_Init(renderbuffer_t &buffer, const renderstate_t &state)
+{
+	for (int i = 0; i < 3; i++)
+		buffer.slots[i] = state;
+
+	buffer.back = 0;
+	buffer.middle = 1;
+	buffer.front = 2;
+}
+
+
+
+renderstate_t &RenderBuffer_Back(renderbuffer_t &buffer)
+{
+	return buffer.slots[buffer.back];
+}
+
+
+
+void RenderBuffer_Publish(renderbuffer_t &buffer)
+{
+	int old = __atomic_exchange_n(&buffer.middle, buffer.back | RENDER_FRESH, __ATOMIC_ACQ_REL);
+
+	buffer.back = old & ~RENDER_FRESH;
+}
+
+
+
+const renderstate_t &RenderBuffer_Latest(renderbuffer_t &buffer)
+{
+	if (RenderBuffer_Fresh(buffer))
+	{
+		int old = __atomic_exchange_n(&buffer.middle, buffer.front, __ATOMIC_ACQ_REL);
+		buffer.front = old & ~RENDER_FRESH;
+	}
+
+	return buffer.slots[buffer.front];
+}
+
+
+
+bool RenderBuffer_Fresh(const renderbuffer_t &buffer)
+{
+	return (__atomic_load_n(&buffer.middle, __ATOMIC_ACQUIRE) & RENDER_FRESH) != 0;
+}
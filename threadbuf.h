@@ -0,0 +1,66 @@
+#ifndef THREADBUF_H
+#define THREADBUF_H
+
+#include <stdint.h>
+
+// --------------------------------------------------------------------------------
+// Thread handoff
+//
+// Lock free structures between the window thread and the sim thread of the
+// -threaded client. Each has exactly one writer and one reader.
+
+// key changes from the window callbacks to the sim thread, which applies them
+// to its key state before building the move command
+#define KEY_QUEUE_SIZE	256				// must be a power of two
+
+struct keyevent_t
+{
+	unsigned char	action;				// ka_*
+	bool			down;
+};
+
+struct keyqueue_t
+{
+	keyevent_t				events[KEY_QUEUE_SIZE];
+	alignas(64) unsigned int	head;	// next push, written by the window thread
+	alignas(64) unsigned int	tail;	// next pop, written by the sim thread
+};
+
+void KeyQueue_Init(keyqueue_t &queue);
+// returns false if the queue is full and the event was dropped
+bool KeyQueue_Push(keyqueue_t &queue, int action, bool down);
+bool KeyQueue_Pop(keyqueue_t &queue, keyevent_t &event);
+
+// what the renderer needs of a sim frame, never changed once published
+struct renderstate_t
+{
+	float			prevx, prevy;
+	float			objx, objy;
+	unsigned int	simtime;
+	unsigned int	droppedtime;		// clock base moved forward by the max steps guard
+	unsigned int	simframe;
+};
+
+// triple buffer of render states: the sim thread fills the back slot and
+// swaps it with the middle one, the window thread swaps the middle slot with
+// its front one when a newer state is there. Neither side ever waits.
+struct renderbuffer_t
+{
+	renderstate_t	slots[3];
+	int				back;				// sim thread
+	int				front;				// window thread
+	alignas(64) int	middle;				// slot index, RENDER_FRESH when unread
+};
+
+#define RENDER_FRESH	4
+
+void RenderBuffer_Init(renderbuffer_t &buffer, const renderstate_t &state);
+// the slot to fill before publishing, owned by the sim thread
+renderstate_t &RenderBuffer_Back(renderbuffer_t &buffer);
+void RenderBuffer_Publish(renderbuffer_t &buffer);
+// the latest published state, owned by the window thread until the next call
+const renderstate_t &RenderBuffer_Latest(renderbuffer_t &buffer);
+// true if a state was published since the last RenderBuffer_Latest
+bool RenderBuffer_Fresh(const renderbuffer_t &buffer);
+
+#endif